@@ -0,0 +1,75 @@
+// Fork throughput for tree search: clones a running NES and discards it,
+// with and without stepping the clone, and reports forks per second.
+//
+// Build and run: make bench && ./bench/bench_clone rom.nes [seconds]
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "nes.h"
+
+#define WARMUP_FRAMES 60
+// A search node typically advances a few frames or a handful of inputs
+#define STEP_INSTRUCTIONS 1000
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef enum { WORK_NONE, WORK_INSTRUCTIONS, WORK_FRAME } Work;
+
+// Clone/step/discard for `seconds`; returns forks per second
+static double run(const NES *root, Work work, double seconds, long *forks) {
+    long n = 0;
+    double t0 = now_sec(), t = t0;
+    while (t - t0 < seconds) {
+        for (int i = 0; i < 256; ++i) {
+            NES child;
+            if (!nes_clone(root, &child)) { fprintf(stderr, "clone failed\n"); exit(1); }
+            if (work == WORK_INSTRUCTIONS) {
+                for (int k = 0; k < STEP_INSTRUCTIONS; ++k) nes_step_instruction(&child);
+            } else if (work == WORK_FRAME) {
+                nes_run_frame(&child);
+            }
+            nes_free(&child);
+        }
+        n += 256;
+        t = now_sec();
+    }
+    *forks = n;
+    return (double)n / (t - t0);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s rom.nes [seconds]\n", argv[0]);
+        return 1;
+    }
+    double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+    if (seconds <= 0) seconds = 1.0;
+
+    NES root;
+    nes_init(&root);
+    int rc = nes_load_rom(&root, argv[1]);
+    if (rc != 0) { fprintf(stderr, "Failed to load ROM (err %d)\n", rc); return 1; }
+    nes_reset(&root);
+    for (int f = 0; f < WARMUP_FRAMES; ++f) nes_run_frame(&root);
+
+    printf("NES struct %zu bytes, PRG RAM %u, CHR RAM %u\n", sizeof(NES), root.cart.prg_ram_size,
+           root.cart.chr_is_ram ? root.cart.chr_size : 0);
+    static const struct { Work work; const char *name; } CASES[] = {
+        { WORK_NONE, "clone + discard" },
+        { WORK_INSTRUCTIONS, "clone + 1000 instructions + discard" },
+        { WORK_FRAME, "clone + 1 frame + discard" },
+    };
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); ++i) {
+        long forks;
+        double rate = run(&root, CASES[i].work, seconds, &forks);
+        printf("%-38s %10.0f /s  (%.2f us each, %ld forks)\n", CASES[i].name, rate, 1e6 / rate, forks);
+    }
+    nes_free(&root);
+    return 0;
+}
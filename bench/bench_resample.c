@@ -0,0 +1,79 @@
+// Resampler throughput: feeds APU-like step deltas through the band-limited
+// step buffer at each output rate and quality, with the portable and SIMD
+// inner loops, and reports cost per delta and speed relative to real time.
+//
+// Build and run: make bench && ./bench/bench_resample [seconds]
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "blip.h"
+
+#define CPU_CLOCK 1789773.0
+#define FRAME_CYCLES 29781
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Emulate `seconds` of audio with a step every `spacing` cycles on average
+// (pseudo-random jitter so phases are spread out). Returns elapsed seconds.
+static double run(Blip *b, double seconds, int spacing, float *out, long *deltas) {
+    uint32_t rng = 0x12345678u;
+    int frames = (int)(seconds * CPU_CLOCK / FRAME_CYCLES);
+    float level = 0.0f;
+    long n = 0;
+    double t0 = now_sec();
+    for (int f = 0; f < frames; ++f) {
+        uint32_t t = 0;
+        for (;;) {
+            rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+            t += 1 + rng % (uint32_t)(2 * spacing);
+            if (t >= FRAME_CYCLES) break;
+            float next = (float)(rng >> 28) / 16.0f;
+            blip_add_delta(b, t, next - level);
+            level = next;
+            ++n;
+        }
+        blip_end_frame(b, FRAME_CYCLES);
+        blip_read_samples(b, out, b->size);
+    }
+    *deltas = n;
+    return now_sec() - t0;
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 20.0;
+    if (seconds <= 0.0) seconds = 20.0;
+    static const int rates[] = { 32000, 44100, 48000, 96000 };
+    static const char *qnames[] = { "low", "medium", "high" };
+    // ~40 cycles is a busy mix (high pulse + noise + triangle); 400 is sparse
+    static const int spacings[] = { 40, 400 };
+
+    printf("%-6s %-7s %-8s %-8s %10s %12s\n", "rate", "quality", "impl", "spacing", "ns/delta", "x realtime");
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r) {
+        for (int q = BLIP_QUALITY_LOW; q <= BLIP_QUALITY_HIGH; ++q) {
+            for (int simd = 1; simd >= 0; --simd) {
+                for (size_t s = 0; s < sizeof(spacings) / sizeof(spacings[0]); ++s) {
+                    Blip b;
+                    int max_samples = rates[r] / 10 + 1;
+                    if (!blip_init(&b, CPU_CLOCK, rates[r], max_samples, (BlipQuality)q)) return 1;
+                    if (!simd) blip_disable_simd(&b);
+                    // Skip the SIMD row when the CPU has no AVX2
+                    if (simd && blip_impl_name(&b)[0] == 'g') { blip_free(&b); continue; }
+                    float *out = (float*)malloc((size_t)max_samples * sizeof(float));
+                    long deltas = 0;
+                    double secs = run(&b, seconds, spacings[s], out, &deltas);
+                    printf("%-6d %-7s %-8s %-8d %10.2f %12.0f\n", rates[r], qnames[q], blip_impl_name(&b),
+                           spacings[s], secs * 1e9 / (double)deltas, seconds / secs);
+                    free(out);
+                    blip_free(&b);
+                }
+            }
+        }
+    }
+    return 0;
+}
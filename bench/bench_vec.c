@@ -0,0 +1,87 @@
+// Vectorized stepping throughput: N cloned environments advanced together
+// by nes_vec_step with random actions, at 1, 2, 4, ... worker threads, with
+// frames per second and scaling relative to one thread.
+//
+// Build and run: make bench && ./bench/bench_vec rom.nes [envs] [max_threads] [repeat] [seconds]
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "nes_vec.h"
+
+#define WARMUP_FRAMES 60
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// A typical RL reward: a byte of RAM (here just the first one)
+static float ram_reward(void *user, const NES *nes, size_t env) {
+    (void)user; (void)env;
+    return (float)nes->bus.ram[0];
+}
+
+// Steps per second for `seconds`, with fresh random actions each step
+static double run(NesVec *v, size_t envs, int repeat, double seconds, uint8_t *actions) {
+    uint32_t rng = 0x9E3779B9u;
+    long steps = 0;
+    double t0 = now_sec(), t = t0;
+    while (t - t0 < seconds) {
+        for (size_t i = 0; i < envs; ++i) {
+            rng = rng * 1664525u + 1013904223u;
+            actions[i] = (uint8_t)(rng >> 24);
+        }
+        nes_vec_step(v, envs, actions, repeat);
+        ++steps;
+        t = now_sec();
+    }
+    return (double)steps / (t - t0);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s rom.nes [envs] [max_threads] [repeat] [seconds]\n", argv[0]);
+        return 1;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t envs = argc > 2 ? (size_t)atol(argv[2]) : 64;
+    int max_threads = argc > 3 ? atoi(argv[3]) : (int)(cpus > 0 ? cpus : 1);
+    int repeat = argc > 4 ? atoi(argv[4]) : 4;
+    double seconds = argc > 5 ? atof(argv[5]) : 2.0;
+    if (envs == 0) envs = 64;
+    if (max_threads <= 0) max_threads = 1;
+    if (repeat <= 0) repeat = 1;
+    if (seconds <= 0) seconds = 2.0;
+
+    NES base;
+    nes_init(&base);
+    int rc = nes_load_rom(&base, argv[1]);
+    if (rc != 0) { fprintf(stderr, "Failed to load ROM (err %d)\n", rc); return 1; }
+    nes_reset(&base);
+    for (int f = 0; f < WARMUP_FRAMES; ++f) nes_run_frame(&base);
+
+    uint8_t *actions = (uint8_t*)calloc(envs, 1);
+    if (!actions) return 1;
+    printf("%zu envs, action repeat %d, %ld online CPUs\n", envs, repeat, cpus);
+    double base_rate = 0.0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        NesVec *v = nes_vec_create(&base, envs, threads);
+        if (!v) { fprintf(stderr, "nes_vec_create failed\n"); return 1; }
+        nes_vec_set_reward(v, ram_reward, NULL);
+        nes_vec_step(v, envs, actions, 1); // first touch of the emulation paths
+        double rate = run(v, envs, repeat, seconds, actions);
+        double fps = rate * (double)envs * (double)repeat;
+        if (threads == 1) base_rate = fps;
+        printf("%3d threads  %8.1f steps/s  %10.0f frames/s  %5.2fx (%.0f%% of linear)\n", threads, rate, fps,
+               fps / base_rate, fps / base_rate / threads * 100.0);
+        nes_vec_destroy(v);
+        if (threads < max_threads && threads * 2 > max_threads) threads = max_threads / 2; // end on max_threads
+    }
+    free(actions);
+    nes_free(&base);
+    return 0;
+}
@@ -1,62 +1,92 @@
 #include "apu.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "apu_queue.h"
+#include "blip.h"
 
-#ifdef HAVE_SDL2
-#include <SDL.h>
-#include <math.h>
-#include "bus.h"
-
-typedef struct APU {
-    SDL_AudioDeviceID dev;
-    SDL_AudioSpec spec;
-    // Pulse 1 state (ultra simplified)
-    double phase;
-    double phase_inc;
-    float volume;
+#define APU_CPU_CLOCK 1789773.0
+#define APU_DEFAULT_RATE 44100
+// Longest stretch synthesized without apu_end_frame before flushing on our own
+#define APU_MAX_FRAME_CYCLES 89489 // ~50 ms
+// Events buffered between the CPU thread and the render thread (~a few frames
+// of heavy register traffic)
+#define APU_QUEUE_CAPACITY 16384
+#define APU_RENDER_BATCH 256
+
+// Envelope generator shared by the pulse and noise channels
+typedef struct {
+    bool constant;  // bit 4: constant volume
+    bool loop;      // bit 5: loop decay (also halts the length counter)
+    uint8_t period; // bits 0-3: volume, or decay period
+    uint8_t decay;  // current decay level (0..15)
+    uint8_t div;
+    bool start;
+} Envelope;
+
+typedef struct {
     bool enabled;
-    uint16_t timer; // 11-bit
+    uint16_t timer;  // 11-bit
+    int timer_ctr;   // CPU cycles until the pending run of sequencer clocks lands
+    uint8_t seq;     // 8-step duty position at the start of that run
+    uint8_t seq_run; // sequencer clocks in the run (output is constant across it)
+    uint8_t duty;    // bits 6-7 of $4000/$4004
+    Envelope env;
+    uint8_t length;
+    // Sweep unit ($4001/$4005)
+    bool sweep_enabled, sweep_negate, sweep_reload;
+    uint8_t sweep_period, sweep_shift, sweep_div;
+    bool ones_complement; // pulse 1 negates as -c-1, pulse 2 as -c
+} Pulse;
+
+// One complete 2A03 sound state. The APU keeps two: a timing-only core on the
+// CPU thread (registers, length counters, frame IRQ, DMC DMA) and, while a
+// sink is attached, a synthesizing copy on the render thread fed from the
+// write queue.
+typedef struct ApuCore {
+    bool synth; // run the waveform channels and produce output
+    Pulse pulse[2];
     // Triangle channel
-    double tri_phase;
-    double tri_inc;
-    float tri_volume;
     bool tri_enabled;
     uint16_t tri_timer;
+    int tri_ctr;
+    uint8_t tri_seq; // 32-step position
     // Noise channel
-    double noise_phase;
-    double noise_inc;
-    float noise_volume;
     bool noise_enabled;
     uint16_t noise_period_index;
-    uint16_t lfsr;
-    bool noise_mode;
+    int noise_ctr;        // CPU cycles until the pending run of LFSR clocks lands
+    bool noise_mode;      // $400E bit 7: short (93-step) sequence
+    uint16_t noise_pos;   // index into the current sequence at the start of the run
+    uint16_t noise_cycle; // which short-mode sequence the LFSR state lies on
+    uint8_t noise_run;    // LFSR clocks in the run (output is constant across it)
 
-    // Frame sequencer
+    // Frame sequencer: an event list walked by absolute CPU cycle
     int frame_mode; // 0=4-step, 1=5-step
     bool irq_inhibit;
-    int cpu_cycle_mod; // cycles since last frame reset
     bool frame_irq;
+    uint64_t seq_origin; // CPU cycle the current sequence started
+    int seq_step;        // next entry in FRAME_SEQ[frame_mode]
+    uint64_t seq_next;   // CPU cycle of that entry
+    uint64_t cycle;      // CPU cycle the APU has been run up to
 
-    // Envelope and length (approximate)
-    // Pulse 1 envelope
-    bool p1_env_const; // $4000 bit4
-    uint8_t p1_env_period; // lower 4 bits
-    uint8_t p1_env_decay; // current decay (0..15)
-    bool p1_env_loop; // bit5
-    bool p1_env_start;
-    uint8_t p1_env_div;
-    uint8_t p1_length; // length counter
     // Triangle linear counter
     uint8_t tri_linear_reload; // $4008
     bool tri_control; // $4008 bit7 (also length counter halt)
     uint8_t tri_length;
     uint8_t tri_linear_counter;
     // Noise envelope/length
-    bool noise_env_const; uint8_t noise_env_period; bool noise_env_loop; uint8_t noise_env_decay; uint8_t noise_length;
-    bool noise_env_start; uint8_t noise_env_div;
+    Envelope noise_env;
+    uint8_t noise_length;
 
     // DMC (basic)
     bool dmc_enabled;
     bool dmc_irq_enable;
     bool dmc_irq_flag;
+    bool dmc_loop;
     uint8_t dmc_rate_index;
     uint8_t dmc_output; // 0..127
     uint16_t dmc_sample_start; // base addr
@@ -65,30 +95,27 @@ typedef struct APU {
     uint16_t dmc_remaining;
     uint8_t dmc_shift_reg;
     uint8_t dmc_bits_remaining;
+    bool dmc_silence;
     bool dmc_buffer_full;
+    bool dmc_dma_pending; // buffer empty with bytes left; waiting on the CPU side
     uint8_t dmc_buffer;
-    double dmc_phase;
-    double dmc_inc;
+    int dmc_ctr;
 
-    // Bus for DMC fetches
-    Bus *bus;
-} APU;
+    // Output: last mixed amplitude and the band-limited step buffer it feeds
+    float amp;
+    uint32_t frame_time; // CPU cycles since last apu_end_frame
+    Blip blip;
+    float *out_buf;
+    int sample_rate;
+    BlipQuality quality;
+    double rate_ratio; // dynamic rate control: output samples per nominal sample
+    AudioSink *sink;   // borrowed; no synthesis output while NULL
+} ApuCore;
 
-static void apu_recalc_phase(APU *a) {
-    if (!a->enabled || a->timer == 0x7FF) { a->phase_inc = 0.0; return; }
-    double cpu = 1789773.0;
-    double freq = cpu / (16.0 * (a->timer + 1));
-    if (freq < 20.0) { a->phase_inc = 0.0; return; }
-    a->phase_inc = freq / (double)a->spec.freq;
-}
-
-static void apu_recalc_triangle(APU *a) {
-    double cpu = 1789773.0;
-    if (!a->tri_enabled) { a->tri_inc = 0.0; return; }
-    double freq = cpu / (32.0 * (a->tri_timer + 1));
-    if (freq < 20.0) { a->tri_inc = 0.0; return; }
-    a->tri_inc = freq / (double)a->spec.freq;
-}
+static const uint8_t LENGTH_TABLE[32] = {
+    10,254,20,2,40,4,80,6,160,8,60,10,14,12,26,14,
+    12,16,24,18,48,20,96,22,192,24,72,26,16,28,32,30
+};
 
 static const int NOISE_PERIODS[16] = {
     4, 8, 16, 32, 64, 96, 128, 160,
@@ -100,224 +127,535 @@ static const int DMC_PERIODS[16] = {
     190, 160, 142, 128, 106, 85,  72,  54
 };
 
-static void apu_recalc_noise(APU *a) {
-    double cpu = 1789773.0;
-    if (!a->noise_enabled) { a->noise_inc = 0.0; return; }
+// Pulse duty sequences, bit n = output at sequencer step n
+static const uint8_t DUTY_TABLE[4] = {
+    0x02, // 0 1 0 0 0 0 0 0  (12.5%)
+    0x06, // 0 1 1 0 0 0 0 0  (25%)
+    0x1E, // 0 1 1 1 1 0 0 0  (50%)
+    0xF9, // 1 0 0 1 1 1 1 1  (25% negated)
+};
+
+// Noise LFSR output sequences as packed bit tables. Bit i is bit 0 of the
+// LFSR after i clocks, so the channel is just an index. The long mode (tap 1)
+// visits all 32767 non-zero states in one sequence; the short mode (tap 6)
+// splits them into 352 sequences of 93 plus one of 31, so short-mode state is
+// (sequence, index). Since the LFSR shifts right, the 15-bit state at an index
+// is the next 15 output bits, which is all a mode switch needs.
+#define NOISE_LONG_LEN 32767
+#define NOISE_SHORT_LEN 93
+#define NOISE_SHORT_SEQS 353
+static uint8_t NOISE_LONG_BITS[(NOISE_LONG_LEN + 7) / 8];
+static uint16_t NOISE_LONG_INDEX[1 << 15];     // state -> index
+static uint8_t NOISE_SHORT_BITS[NOISE_SHORT_SEQS][(NOISE_SHORT_LEN + 7) / 8];
+static uint8_t NOISE_SHORT_SEQ_LEN[NOISE_SHORT_SEQS];
+static uint16_t NOISE_SHORT_LOC[1 << 15];      // state -> sequence << 7 | index
+static pthread_once_t noise_tables_once = PTHREAD_ONCE_INIT;
+
+static uint16_t lfsr_clock(uint16_t s, int tap) {
+    uint16_t fb = (uint16_t)((s ^ (s >> tap)) & 1);
+    return (uint16_t)((s >> 1) | (fb << 14));
+}
+
+static void noise_build_tables(void) {
+    uint16_t s = 1;
+    for (int i = 0; i < NOISE_LONG_LEN; ++i) {
+        NOISE_LONG_INDEX[s] = (uint16_t)i;
+        if (s & 1) NOISE_LONG_BITS[i >> 3] |= (uint8_t)(1u << (i & 7));
+        s = lfsr_clock(s, 1);
+    }
+    memset(NOISE_SHORT_LOC, 0xFF, sizeof(NOISE_SHORT_LOC));
+    int seqs = 0;
+    for (int start = 1; start < (1 << 15); ++start) {
+        if (NOISE_SHORT_LOC[start] != 0xFFFF) continue;
+        int i = 0;
+        s = (uint16_t)start;
+        do {
+            NOISE_SHORT_LOC[s] = (uint16_t)(seqs << 7 | i);
+            if (s & 1) NOISE_SHORT_BITS[seqs][i >> 3] |= (uint8_t)(1u << (i & 7));
+            s = lfsr_clock(s, 6);
+            ++i;
+        } while (s != start);
+        NOISE_SHORT_SEQ_LEN[seqs++] = (uint8_t)i;
+    }
+}
+
+// Frame sequencer steps in CPU cycles after a $4017 write (NTSC)
+enum { SEQ_QUARTER = 1, SEQ_HALF = 2, SEQ_IRQ = 4 };
+typedef struct { int cycle; uint8_t actions; } FrameStep;
+static const FrameStep FRAME_SEQ[2][5] = {
+    { {7457, SEQ_QUARTER}, {14913, SEQ_QUARTER | SEQ_HALF}, {22371, SEQ_QUARTER},
+      {29829, SEQ_QUARTER | SEQ_HALF | SEQ_IRQ} },
+    { {7457, SEQ_QUARTER}, {14913, SEQ_QUARTER | SEQ_HALF}, {22371, SEQ_QUARTER},
+      {29829, 0}, {37281, SEQ_QUARTER | SEQ_HALF} },
+};
+static const int FRAME_SEQ_LEN[2] = { 4, 5 };
+static const int FRAME_SEQ_PERIOD[2] = { 29830, 37282 };
+#define FRAME_SEQ_IRQ_CYCLE 29829
+
+static const uint8_t TRI_SEQ[32] = {
+    15,14,13,12,11,10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+     0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15
+};
+
+static inline int noise_seq_len(const ApuCore *a) {
+    return a->noise_mode ? NOISE_SHORT_SEQ_LEN[a->noise_cycle] : NOISE_LONG_LEN;
+}
+
+static inline int noise_bit(const ApuCore *a, int pos) {
+    const uint8_t *bits = a->noise_mode ? NOISE_SHORT_BITS[a->noise_cycle] : NOISE_LONG_BITS;
+    return (bits[pos >> 3] >> (pos & 7)) & 1;
+}
+
+// Plan the next run: clock until the output bit changes (at most 7 steps
+// for any duty, at most 15 for the LFSR), so one event covers many periods
+static void pulse_plan(Pulse *p) {
+    int out = (DUTY_TABLE[p->duty] >> p->seq) & 1, k = 1;
+    while (((DUTY_TABLE[p->duty] >> ((p->seq + k) & 7)) & 1) == out) ++k;
+    p->seq_run = (uint8_t)k;
+    p->timer_ctr = k * (p->timer + 1) * 2;
+}
+
+static void noise_plan(ApuCore *a) {
+    int len = noise_seq_len(a), out = noise_bit(a, a->noise_pos), k = 1, pos = a->noise_pos + 1;
+    for (;; ++k, ++pos) {
+        if (pos >= len) pos -= len;
+        if (noise_bit(a, pos) != out || k >= len) break;
+    }
+    a->noise_run = (uint8_t)k;
+    a->noise_ctr = k * NOISE_PERIODS[a->noise_period_index & 0x0F];
+}
+
+// Cut the pending run down to its current timer period, before a register
+// write changes the period, duty or sequence. The period in progress keeps
+// its remaining count, as the hardware divider does.
+static void pulse_split(Pulse *p) {
+    int period = (p->timer + 1) * 2;
+    int left = (p->timer_ctr + period - 1) / period;
+    if (left > p->seq_run) left = p->seq_run; // already a lone, older-period step
+    p->seq = (uint8_t)((p->seq + p->seq_run - left) & 7);
+    p->seq_run = 1;
+    p->timer_ctr -= (left - 1) * period;
+}
+
+static void noise_split(ApuCore *a) {
     int period = NOISE_PERIODS[a->noise_period_index & 0x0F];
-    double freq = cpu / (double)period;
-    if (freq < 20.0) { a->noise_inc = 0.0; return; }
-    a->noise_inc = freq / (double)a->spec.freq;
-}
-
-static void SDLCALL audio_cb(void *ud, Uint8 *stream, int len) {
-    APU *a = (APU*)ud;
-    int samples = len / (int)sizeof(float);
-    float *out = (float*)stream;
-    for (int i = 0; i < samples; ++i) {
-        // Pulse amplitude 0..15
-        float pulse_amp = 0.0f;
-        if (a->phase_inc > 0.0 && a->p1_length > 0) {
-            double ph = a->phase; a->phase += a->phase_inc; if (a->phase >= 1.0) a->phase -= 1.0;
-            double duty = 0.125; // 12.5%
-            float env = (float)(a->p1_env_const ? a->p1_env_period : a->p1_env_decay);
-            pulse_amp = (ph < duty ? env : 0.0f);
+    int left = (a->noise_ctr + period - 1) / period;
+    if (left > a->noise_run) left = a->noise_run;
+    a->noise_pos = (uint16_t)((a->noise_pos + a->noise_run - left) % noise_seq_len(a));
+    a->noise_run = 1;
+    a->noise_ctr -= (left - 1) * period;
+}
+
+// Switch LFSR feedback mode, keeping the shift register contents
+static void noise_set_mode(ApuCore *a, bool mode) {
+    if (mode == a->noise_mode) return;
+    int len = noise_seq_len(a);
+    uint16_t state = 0;
+    for (int j = 0, pos = a->noise_pos; j < 15; ++j, pos = pos + 1 < len ? pos + 1 : 0)
+        state |= (uint16_t)(noise_bit(a, pos) << j);
+    a->noise_mode = mode;
+    if (mode) {
+        a->noise_cycle = (uint16_t)(NOISE_SHORT_LOC[state] >> 7);
+        a->noise_pos = (uint16_t)(NOISE_SHORT_LOC[state] & 0x7F);
+    } else {
+        a->noise_cycle = 0;
+        a->noise_pos = NOISE_LONG_INDEX[state];
+    }
+}
+
+static inline int envelope_volume(const Envelope *e) {
+    return e->constant ? e->period : e->decay;
+}
+
+// Period the sweep unit would move to; also drives muting
+static inline int pulse_sweep_target(const Pulse *p) {
+    int delta = p->timer >> p->sweep_shift;
+    if (p->sweep_negate) return p->timer - delta - (p->ones_complement ? 1 : 0);
+    return p->timer + delta;
+}
+
+// Muted by a too-high or too-low period even when the sweep is disabled
+static inline bool pulse_muted(const Pulse *p) {
+    return p->timer < 8 || pulse_sweep_target(p) > 0x7FF;
+}
+
+// Current channel output levels (0..15, DMC 0..127)
+static inline int pulse_level(const Pulse *p) {
+    if (!p->enabled || p->length == 0 || pulse_muted(p)) return 0;
+    if (!((DUTY_TABLE[p->duty] >> p->seq) & 1)) return 0;
+    return envelope_volume(&p->env);
+}
+
+static inline int tri_level(const ApuCore *a) {
+    return TRI_SEQ[a->tri_seq];
+}
+
+static inline int noise_level(const ApuCore *a) {
+    if (!a->noise_enabled || a->noise_length == 0 || noise_bit(a, a->noise_pos)) return 0;
+    return envelope_volume(&a->noise_env);
+}
+
+// Non-linear mixer lookup tables (nesdev "Lookup Table" approximation):
+//   PULSE_TABLE[n]  = 95.52  / (8128.0  / n + 100), n = pulse1 + pulse2
+//   TND_TABLE[n]    = 163.67 / (24329.0 / n + 100), n = 3*tri + 2*noise + dmc
+static const float PULSE_TABLE[31] = {
+    0.000000000f, 0.011609140f, 0.022939481f, 0.034000948f, 0.044803001f, 0.055354659f, 0.065664530f, 0.075740822f,
+    0.085591398f, 0.095223747f, 0.104645051f, 0.113862157f, 0.122881643f, 0.131709799f, 0.140352651f, 0.148815960f,
+    0.157105267f, 0.165225878f, 0.173182920f, 0.180981249f, 0.188625589f, 0.196120456f, 0.203470185f, 0.210678935f,
+    0.217750758f, 0.224689499f, 0.231498882f, 0.238182485f, 0.244743779f, 0.251186073f, 0.257512569f,
+};
+
+static const float TND_TABLE[203] = {
+    0.000000000f, 0.006699824f, 0.013345020f, 0.019936254f, 0.026474180f, 0.032959443f, 0.039392676f, 0.045774501f,
+    0.052105535f, 0.058386382f, 0.064617634f, 0.070799872f, 0.076933682f, 0.083019629f, 0.089058258f, 0.095050134f,
+    0.100995794f, 0.106895767f, 0.112750582f, 0.118560754f, 0.124326788f, 0.130049184f, 0.135728449f, 0.141365051f,
+    0.146959484f, 0.152512208f, 0.158023685f, 0.163494393f, 0.168924764f, 0.174315259f, 0.179666296f, 0.184978306f,
+    0.190251738f, 0.195486993f, 0.200684488f, 0.205844626f, 0.210967809f, 0.216054440f, 0.221104905f, 0.226119593f,
+    0.231098875f, 0.236043125f, 0.240952715f, 0.245828003f, 0.250669360f, 0.255477130f, 0.260251641f, 0.264993280f,
+    0.269702345f, 0.274379224f, 0.279024184f, 0.283637583f, 0.288219720f, 0.292770922f, 0.297291547f, 0.301781833f,
+    0.306242108f, 0.310672671f, 0.315073848f, 0.319445908f, 0.323789120f, 0.328103781f, 0.332390189f, 0.336648613f,
+    0.340879291f, 0.345082551f, 0.349258631f, 0.353407770f, 0.357530266f, 0.361626387f, 0.365696311f, 0.369740367f,
+    0.373758763f, 0.377751738f, 0.381719559f, 0.385662436f, 0.389580637f, 0.393474340f, 0.397343844f, 0.401189297f,
+    0.405010968f, 0.408809096f, 0.412583858f, 0.416335464f, 0.420064151f, 0.423770130f, 0.427453607f, 0.431114763f,
+    0.434753835f, 0.438371003f, 0.441966444f, 0.445540398f, 0.449093014f, 0.452624530f, 0.456135064f, 0.459624887f,
+    0.463094115f, 0.466542959f, 0.469971567f, 0.473380178f, 0.476768911f, 0.480137974f, 0.483487517f, 0.486817688f,
+    0.490128726f, 0.493420720f, 0.496693879f, 0.499948323f, 0.503184259f, 0.506401837f, 0.509601176f, 0.512782454f,
+    0.515945852f, 0.519091487f, 0.522219479f, 0.525330067f, 0.528423250f, 0.531499326f, 0.534558415f, 0.537600517f,
+    0.540625930f, 0.543634713f, 0.546627045f, 0.549603045f, 0.552562833f, 0.555506527f, 0.558434308f, 0.561346233f,
+    0.564242482f, 0.567123234f, 0.569988489f, 0.572838426f, 0.575673223f, 0.578492939f, 0.581297696f, 0.584087610f,
+    0.586862803f, 0.589623451f, 0.592369616f, 0.595101357f, 0.597818911f, 0.600522280f, 0.603211582f, 0.605887055f,
+    0.608548641f, 0.611196518f, 0.613830805f, 0.616451621f, 0.619059026f, 0.621653140f, 0.624234021f, 0.626801848f,
+    0.629356682f, 0.631898582f, 0.634427726f, 0.636944175f, 0.639448047f, 0.641939342f, 0.644418240f, 0.646884859f,
+    0.649339199f, 0.651781380f, 0.654211581f, 0.656629741f, 0.659036040f, 0.661430597f, 0.663813412f, 0.666184664f,
+    0.668544352f, 0.670892596f, 0.673229456f, 0.675555050f, 0.677869439f, 0.680172741f, 0.682464957f, 0.684746206f,
+    0.687016606f, 0.689276218f, 0.691525102f, 0.693763316f, 0.695990920f, 0.698208094f, 0.700414777f, 0.702611148f,
+    0.704797208f, 0.706973076f, 0.709138811f, 0.711294472f, 0.713440120f, 0.715575874f, 0.717701793f, 0.719817877f,
+    0.721924245f, 0.724020958f, 0.726108074f, 0.728185654f, 0.730253816f, 0.732312560f, 0.734362006f, 0.736402154f,
+    0.738433063f, 0.740454912f, 0.742467582f,
+};
+
+static float apu_mix(const ApuCore *a) {
+    return PULSE_TABLE[pulse_level(&a->pulse[0]) + pulse_level(&a->pulse[1])]
+         + TND_TABLE[3 * tri_level(a) + 2 * noise_level(a) + a->dmc_output];
+}
+
+// Re-evaluate the mixer and emit the amplitude change into the step buffer
+static void apu_update_output(ApuCore *a) {
+    if (!a->sink) return;
+    float amp = apu_mix(a);
+    if (amp != a->amp) {
+        blip_add_delta(&a->blip, a->frame_time, amp - a->amp);
+        a->amp = amp;
+    }
+}
+
+// The sample buffer wants a byte: raise a DMA request for the CPU side to
+// service (apu_dmc_dma_complete) rather than reading memory from in here
+static void dmc_request(ApuCore *a) {
+    if (!a->dmc_buffer_full && a->dmc_remaining > 0) a->dmc_dma_pending = true;
+}
+
+static void core_dma_complete(ApuCore *a, uint8_t value) {
+    if (!a || !a->dmc_dma_pending) return;
+    a->dmc_dma_pending = false;
+    if (a->dmc_buffer_full || a->dmc_remaining == 0) return;
+    a->dmc_buffer = value;
+    a->dmc_buffer_full = true;
+    a->dmc_cur_addr++;
+    if (a->dmc_cur_addr == 0x0000) a->dmc_cur_addr = 0x8000; // wrap
+    a->dmc_remaining--;
+    if (a->dmc_remaining == 0) {
+        if (a->dmc_loop) {
+            a->dmc_cur_addr = a->dmc_sample_start;
+            a->dmc_remaining = a->dmc_sample_length;
+        } else if (a->dmc_irq_enable) {
+            a->dmc_irq_flag = true;
+        }
+    }
+}
+
+static void dmc_clock(ApuCore *a) {
+    // Output bit adjusts 7-bit output towards max/min by 2
+    if (!a->dmc_silence) {
+        if (a->dmc_shift_reg & 1) {
+            if (a->dmc_output <= 125) a->dmc_output += 2;
+        } else {
+            if (a->dmc_output >= 2) a->dmc_output -= 2;
         }
+    }
+    a->dmc_shift_reg >>= 1;
+    if (a->dmc_bits_remaining) a->dmc_bits_remaining--;
+    if (a->dmc_bits_remaining == 0) {
+        a->dmc_bits_remaining = 8;
+        if (a->dmc_buffer_full) {
+            a->dmc_silence = false;
+            a->dmc_shift_reg = a->dmc_buffer;
+            a->dmc_buffer_full = false;
+            dmc_request(a);
+        } else {
+            a->dmc_silence = true;
+        }
+    }
+}
 
-        // Triangle amplitude 0..15
-        float tri_amp = 0.0f;
-        if (a->tri_inc > 0.0 && a->tri_length > 0 && a->tri_linear_counter > 0) {
-            double t = a->tri_phase; a->tri_phase += a->tri_inc; if (a->tri_phase >= 1.0) a->tri_phase -= 1.0;
-            double tri = (t < 0.5 ? (t * 2.0) : (2.0 - t * 2.0));
-            tri_amp = (float)(tri * 15.0);
+// Advance all channel timers by `cycles` CPU cycles, emitting a step at every
+// output change. Work scales with the number of transitions, not samples.
+static void apu_run(ApuCore *a, int cycles) {
+    if (!a->synth) {
+        // Timing core: of the channel timers only the DMC is visible to the
+        // CPU (sample end, IRQ, DMA requests)
+        while (cycles >= a->dmc_ctr) {
+            cycles -= a->dmc_ctr;
+            a->dmc_ctr = DMC_PERIODS[a->dmc_rate_index & 0x0F];
+            if (a->dmc_enabled || !a->dmc_silence) dmc_clock(a);
         }
+        a->dmc_ctr -= cycles;
+        return;
+    }
+    while (cycles > 0) {
+        int step = cycles;
+        if (a->pulse[0].timer_ctr < step) step = a->pulse[0].timer_ctr;
+        if (a->pulse[1].timer_ctr < step) step = a->pulse[1].timer_ctr;
+        if (a->tri_ctr < step) step = a->tri_ctr;
+        if (a->noise_ctr < step) step = a->noise_ctr;
+        if (a->dmc_ctr < step) step = a->dmc_ctr;
+
+        a->pulse[0].timer_ctr -= step;
+        a->pulse[1].timer_ctr -= step;
+        a->tri_ctr -= step;
+        a->noise_ctr -= step;
+        a->dmc_ctr -= step;
+        a->frame_time += (uint32_t)step;
+        cycles -= step;
 
-        // Noise amplitude 0..15
-        float noise_amp = 0.0f;
-        if (a->noise_inc > 0.0 && a->noise_length > 0) {
-            a->noise_phase += a->noise_inc;
-            if (a->noise_phase >= 1.0) {
-                a->noise_phase -= 1.0;
-                uint16_t tap = a->noise_mode ? 6 : 1;
-                uint16_t bit = (uint16_t)(((a->lfsr ^ (a->lfsr >> tap)) & 1));
-                a->lfsr = (uint16_t)((a->lfsr >> 1) | (bit << 14));
+        bool changed = false;
+        for (int i = 0; i < 2; ++i) {
+            Pulse *p = &a->pulse[i];
+            if (p->timer_ctr == 0) {
+                p->seq = (uint8_t)((p->seq + p->seq_run) & 7);
+                pulse_plan(p);
+                changed = true;
+            }
+        }
+        if (a->tri_ctr == 0) {
+            a->tri_ctr = a->tri_timer + 1;
+            // Ultrasonic periods are held rather than clocked to avoid popping
+            if (a->tri_length > 0 && a->tri_linear_counter > 0 && a->tri_timer >= 2) {
+                a->tri_seq = (uint8_t)((a->tri_seq + 1) & 31);
+                changed = true;
+            }
+        }
+        if (a->noise_ctr == 0) {
+            int pos = a->noise_pos + a->noise_run, len = noise_seq_len(a);
+            a->noise_pos = (uint16_t)(pos >= len ? pos - len : pos);
+            noise_plan(a);
+            changed = true;
+        }
+        if (a->dmc_ctr == 0) {
+            a->dmc_ctr = DMC_PERIODS[a->dmc_rate_index & 0x0F];
+            if (a->dmc_enabled || !a->dmc_silence) {
+                dmc_clock(a);
+                changed = true;
             }
-            float env = (float)(a->noise_env_const ? a->noise_env_period : a->noise_env_decay);
-            noise_amp = (a->lfsr & 1) ? env : 0.0f;
         }
+        if (changed) apu_update_output(a);
+    }
+}
+
+// Envelope tick: decay towards 0, loop if set
+static void envelope_clock(Envelope *e) {
+    if (e->start) {
+        e->start = false;
+        e->decay = 15;
+        e->div = e->period;
+    } else if (e->div > 0) {
+        e->div--;
+    } else {
+        e->div = e->period;
+        if (e->decay > 0) e->decay--; else if (e->loop) e->decay = 15;
+    }
+}
+
+// Half-frame sweep clock; may retune the channel
+static void pulse_sweep_clock(Pulse *p) {
+    if (p->sweep_div == 0 && p->sweep_enabled && p->sweep_shift > 0 && !pulse_muted(p)) {
+        pulse_split(p);
+        p->timer = (uint16_t)pulse_sweep_target(p);
+    }
+    if (p->sweep_div == 0 || p->sweep_reload) {
+        p->sweep_div = p->sweep_period;
+        p->sweep_reload = false;
+    } else {
+        p->sweep_div--;
+    }
+}
 
-        float dmc_amp = (float)a->dmc_output; // 0..127
+static void apu_quarter_frame(ApuCore *a) {
+    envelope_clock(&a->pulse[0].env);
+    envelope_clock(&a->pulse[1].env);
+    envelope_clock(&a->noise_env);
+    // Triangle linear counter reload if control flag set
+    if (a->tri_control) {
+        a->tri_linear_counter = a->tri_linear_reload;
+    } else if (a->tri_linear_counter > 0) {
+        a->tri_linear_counter--;
+    }
+}
 
-        // NES mixing formulas
-        float pulse_sum = pulse_amp; // only pulse 1
-        float pulse_out = (pulse_sum <= 0.0f) ? 0.0f : (95.88f / (8128.0f / pulse_sum + 100.0f));
-        float tnd_in = (tri_amp / 8227.0f) + (noise_amp / 12241.0f) + (dmc_amp / 22638.0f);
-        float tnd_out = (tnd_in <= 0.0f) ? 0.0f : (159.79f / (1.0f / tnd_in + 100.0f));
-        float s = pulse_out + tnd_out;
-        if (s > 1.0f) s = 1.0f; else if (s < 0.0f) s = 0.0f;
-        out[i] = (s * 2.0f - 1.0f);
+static void apu_half_frame(ApuCore *a) {
+    // Length counters and sweep units
+    for (int i = 0; i < 2; ++i) {
+        Pulse *p = &a->pulse[i];
+        if (!p->env.loop && p->length > 0) p->length--;
+        pulse_sweep_clock(p);
     }
+    if (!a->tri_control && a->tri_length > 0) a->tri_length--;
+    if (!a->noise_env.loop && a->noise_length > 0) a->noise_length--;
 }
 
-bool apu_init(APU **out) {
-    if (SDL_WasInit(SDL_INIT_AUDIO) == 0) {
-        if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
-            *out = NULL; return false;
-        }
+// (Re)build the step buffer for a new output rate; pending output is dropped
+static bool core_alloc_output(ApuCore *a, int sample_rate) {
+    int max_samples = sample_rate / 10 + 1; // ~100 ms between reads
+    float *buf = (float*)calloc((size_t)max_samples, sizeof(float));
+    if (!buf) return false;
+    blip_free(&a->blip);
+    free(a->out_buf);
+    a->out_buf = buf;
+    if (!blip_init(&a->blip, APU_CPU_CLOCK, (double)sample_rate * a->rate_ratio, max_samples, a->quality)) {
+        free(a->out_buf); a->out_buf = NULL; return false;
     }
-    APU *a = (APU*)SDL_calloc(1, sizeof(APU));
-    if (!a) { *out = NULL; return false; }
-    a->volume = 0.1f;
-    a->enabled = true;
-    a->phase = 0.0;
-    a->phase_inc = 0.0;
-    a->timer = 0x7FF; // silent until configured
-    a->tri_volume = 0.1f; a->tri_enabled = false; a->tri_timer = 0x7FF; a->tri_phase = 0.0; a->tri_inc = 0.0;
-    a->noise_volume = 0.05f; a->noise_enabled = false; a->noise_period_index = 0; a->noise_phase = 0.0; a->noise_inc = 0.0; a->lfsr = 1; a->noise_mode = false;
-    a->frame_mode = 0; a->irq_inhibit = true; a->cpu_cycle_mod = 0; a->frame_irq = false;
-    a->p1_env_const = false; a->p1_env_period = 0; a->p1_env_decay = 15; a->p1_env_loop = false; a->p1_env_start = false; a->p1_env_div = 0; a->p1_length = 0;
-    a->tri_linear_reload = 0; a->tri_control = false; a->tri_length = 0; a->tri_linear_counter = 0;
-    a->noise_env_const = false; a->noise_env_period = 0; a->noise_env_loop = false; a->noise_env_decay = 15; a->noise_env_start = false; a->noise_env_div = 0; a->noise_length = 0;
-    // DMC defaults
-    a->dmc_enabled = false; a->dmc_irq_enable = false; a->dmc_irq_flag = false;
-    a->dmc_rate_index = 0; a->dmc_output = 0x20; a->dmc_sample_start = 0xC000; a->dmc_sample_length = 1;
-    a->dmc_cur_addr = 0; a->dmc_remaining = 0; a->dmc_shift_reg = 0; a->dmc_bits_remaining = 0;
-    a->dmc_buffer_full = false; a->dmc_buffer = 0; a->dmc_phase = 0.0; a->dmc_inc = 0.0; a->bus = NULL;
-
-    SDL_AudioSpec want = {0};
-    want.freq = 44100;
-    want.format = AUDIO_F32;
-    want.channels = 1;
-    want.samples = 1024;
-    want.callback = audio_cb;
-    want.userdata = a;
-    a->dev = SDL_OpenAudioDevice(NULL, 0, &want, &a->spec, 0);
-    if (!a->dev) { SDL_free(a); *out = NULL; return false; }
-    SDL_PauseAudioDevice(a->dev, 0);
-    *out = a;
+    a->sample_rate = sample_rate;
     return true;
 }
 
-void apu_connect_bus(APU *a, Bus *b) {
-    (void)a; (void)b;
-    // Current simple implementation does not use bus; placeholder for DMC
-}
+static void core_run_until(ApuCore *a, uint64_t cpu_cycle);
+static void core_end_frame(ApuCore *a);
 
-void apu_shutdown(APU **pa) {
-    if (!pa || !*pa) return;
-    APU *a = *pa; *pa = NULL;
-    if (a->dev) {
-        SDL_PauseAudioDevice(a->dev, 1);
-        SDL_CloseAudioDevice(a->dev);
+// Power-on register state
+static void core_power_on(ApuCore *a) {
+    memset(a, 0, sizeof(*a));
+    for (int i = 0; i < 2; ++i) {
+        Pulse *p = &a->pulse[i];
+        p->timer = 0x7FF; // silent until configured
+        p->env.decay = 15;
+        p->ones_complement = (i == 0);
+        pulse_plan(p);
     }
-    SDL_free(a);
+    a->tri_enabled = false; a->tri_timer = 0x7FF; a->tri_ctr = a->tri_timer + 1; a->tri_seq = 0;
+    a->noise_enabled = false; a->noise_period_index = 0; a->noise_mode = false;
+    a->noise_pos = 0; a->noise_cycle = 0; noise_plan(a); // LFSR = 1
+    a->frame_mode = 0; a->irq_inhibit = true; a->frame_irq = false;
+    a->cycle = 0; a->seq_origin = 0; a->seq_step = 0; a->seq_next = (uint64_t)FRAME_SEQ[0][0].cycle;
+    a->tri_linear_reload = 0; a->tri_control = false; a->tri_length = 0; a->tri_linear_counter = 0;
+    a->noise_env.decay = 15; a->noise_length = 0;
+    // DMC defaults
+    a->dmc_enabled = false; a->dmc_irq_enable = false; a->dmc_irq_flag = false; a->dmc_loop = false;
+    a->dmc_rate_index = 0; a->dmc_output = 0x20; a->dmc_sample_start = 0xC000; a->dmc_sample_length = 1;
+    a->dmc_cur_addr = 0; a->dmc_remaining = 0; a->dmc_shift_reg = 0; a->dmc_bits_remaining = 8; a->dmc_silence = true;
+    a->dmc_buffer_full = false; a->dmc_dma_pending = false; a->dmc_buffer = 0; a->dmc_ctr = DMC_PERIODS[0];
+
+    a->rate_ratio = 1.0;
+    a->quality = BLIP_QUALITY_MEDIUM;
 }
 
-void apu_write(APU *a, uint16_t addr, uint8_t data) {
+static void core_write(ApuCore *a, uint64_t cpu_cycle, uint16_t addr, uint8_t data) {
     if (!a) return;
+    core_run_until(a, cpu_cycle);
     switch (addr) {
-        case 0x4000: {
-            // Duty ignored; envelope
-            a->p1_env_const = (data & 0x10) != 0;
-            a->p1_env_loop = (data & 0x20) != 0;
-            a->p1_env_period = (uint8_t)(data & 0x0F);
-            float v = (float)(a->p1_env_const ? a->p1_env_period : a->p1_env_decay) / 15.0f;
-            a->volume = v * 0.2f;
+        case 0x4000: case 0x4004: { // Pulse duty and envelope
+            Pulse *p = &a->pulse[(addr >> 2) & 1];
+            pulse_split(p);
+            p->duty = (uint8_t)(data >> 6);
+            p->env.constant = (data & 0x10) != 0;
+            p->env.loop = (data & 0x20) != 0;
+            p->env.period = (uint8_t)(data & 0x0F);
             break;
         }
-        case 0x4001: {
-            // Sweep (ignored in audio generation; placeholder)
-            (void)data; break;
+        case 0x4001: case 0x4005: { // Pulse sweep
+            Pulse *p = &a->pulse[(addr >> 2) & 1];
+            p->sweep_enabled = (data & 0x80) != 0;
+            p->sweep_period = (uint8_t)((data >> 4) & 7);
+            p->sweep_negate = (data & 0x08) != 0;
+            p->sweep_shift = (uint8_t)(data & 7);
+            p->sweep_reload = true;
+            break;
         }
-        case 0x4002: {
-            a->timer = (uint16_t)((a->timer & 0x0700) | data);
-            apu_recalc_phase(a);
+        case 0x4002: case 0x4006: { // Pulse timer low
+            Pulse *p = &a->pulse[(addr >> 2) & 1];
+            pulse_split(p);
+            p->timer = (uint16_t)((p->timer & 0x0700) | data);
             break;
         }
-        case 0x4003: {
-            a->timer = (uint16_t)(((data & 0x07) << 8) | (a->timer & 0x00FF));
-            a->phase = 0.0; // restart
-            // Length counter load from table
-            static const uint8_t LENGTH_TABLE[32] = {
-                10,254,20,2,40,4,80,6,160,8,60,10,14,12,26,14,
-                12,16,24,18,48,20,96,22,192,24,72,26,16,28,32,30
-            };
-            a->p1_length = LENGTH_TABLE[(data >> 3) & 0x1F];
-            a->p1_env_start = true;
-            apu_recalc_phase(a);
+        case 0x4003: case 0x4007: { // Pulse timer high and length
+            Pulse *p = &a->pulse[(addr >> 2) & 1];
+            pulse_split(p);
+            p->timer = (uint16_t)(((data & 0x07) << 8) | (p->timer & 0x00FF));
+            p->seq = 0; // restart
+            if (p->enabled) p->length = LENGTH_TABLE[(data >> 3) & 0x1F];
+            p->env.start = true;
             break;
         }
-        case 0x4008: { // Triangle linear counter (ignored); use low 4 bits as volume
+        case 0x4008: { // Triangle linear counter
             a->tri_control = (data & 0x80) != 0;
             a->tri_linear_reload = (uint8_t)(data & 0x7F);
-            a->tri_volume = (float)(a->tri_linear_counter & 0x1F) / 31.0f * 0.2f;
             break;
         }
         case 0x400A: { // Triangle timer low
             a->tri_timer = (uint16_t)((a->tri_timer & 0x0700) | data);
-            apu_recalc_triangle(a);
             break;
         }
         case 0x400B: { // Triangle timer high
             a->tri_timer = (uint16_t)(((data & 0x07) << 8) | (a->tri_timer & 0x00FF));
-            a->tri_phase = 0.0;
-            static const uint8_t LENGTH_TABLE[32] = {
-                10,254,20,2,40,4,80,6,160,8,60,10,14,12,26,14,
-                12,16,24,18,48,20,96,22,192,24,72,26,16,28,32,30
-            };
-            a->tri_length = LENGTH_TABLE[(data >> 3) & 0x1F];
+            if (a->tri_enabled) a->tri_length = LENGTH_TABLE[(data >> 3) & 0x1F];
             a->tri_linear_counter = a->tri_linear_reload;
-            apu_recalc_triangle(a);
             break;
         }
         case 0x400C: { // Noise volume
-            a->noise_env_const = (data & 0x10) != 0;
-            a->noise_env_loop = (data & 0x20) != 0;
-            a->noise_env_period = (uint8_t)(data & 0x0F);
-            float v = (float)(a->noise_env_const ? a->noise_env_period : a->noise_env_decay) / 15.0f;
-            a->noise_volume = v * 0.2f;
+            a->noise_env.constant = (data & 0x10) != 0;
+            a->noise_env.loop = (data & 0x20) != 0;
+            a->noise_env.period = (uint8_t)(data & 0x0F);
             break;
         }
         case 0x400E: { // Noise period index
+            noise_split(a);
             a->noise_period_index = (uint16_t)(data & 0x0F);
-            a->noise_mode = (data & 0x80) != 0;
-            apu_recalc_noise(a);
+            noise_set_mode(a, (data & 0x80) != 0);
             break;
         }
-        case 0x400F: { // Noise length; also reset LFSR
-            a->lfsr = 1;
-            static const uint8_t LENGTH_TABLE[32] = {
-                10,254,20,2,40,4,80,6,160,8,60,10,14,12,26,14,
-                12,16,24,18,48,20,96,22,192,24,72,26,16,28,32,30
-            };
-            a->noise_length = LENGTH_TABLE[(data >> 3) & 0x1F];
-            a->noise_env_start = true;
+        case 0x400F: { // Noise length
+            if (a->noise_enabled) a->noise_length = LENGTH_TABLE[(data >> 3) & 0x1F];
+            a->noise_env.start = true;
             break;
         }
         case 0x4015: {
-            a->enabled = (data & 0x01) != 0;
+            for (int i = 0; i < 2; ++i) {
+                a->pulse[i].enabled = (data & (1 << i)) != 0;
+                if (!a->pulse[i].enabled) a->pulse[i].length = 0;
+            }
             a->tri_enabled = (data & 0x04) != 0;
             a->noise_enabled = (data & 0x08) != 0;
+            if (!a->tri_enabled) a->tri_length = 0;
+            if (!a->noise_enabled) a->noise_length = 0;
             bool dmc_en = (data & 0x10) != 0;
+            a->dmc_irq_flag = false;
             if (dmc_en && !a->dmc_enabled) {
                 a->dmc_enabled = true;
                 if (a->dmc_remaining == 0) {
                     a->dmc_cur_addr = a->dmc_sample_start;
                     a->dmc_remaining = a->dmc_sample_length;
                 }
+                dmc_request(a);
             } else if (!dmc_en) {
                 a->dmc_enabled = false;
                 a->dmc_remaining = 0;
             }
-            apu_recalc_phase(a);
-            apu_recalc_triangle(a);
-            apu_recalc_noise(a);
             break;
         }
         case 0x4010: { // DMC control
             a->dmc_irq_enable = (data & 0x80) != 0;
+            a->dmc_loop = (data & 0x40) != 0;
             a->dmc_rate_index = (uint8_t)(data & 0x0F);
-            double cpu = 1789773.0; int period = DMC_PERIODS[a->dmc_rate_index];
-            a->dmc_inc = (cpu / (double)period) / (double)a->spec.freq;
+            if (!a->dmc_irq_enable) a->dmc_irq_flag = false;
             break;
         }
         case 0x4011: { // DMC direct load
@@ -333,152 +671,453 @@ void apu_write(APU *a, uint16_t addr, uint8_t data) {
             break;
         }
         case 0x4017: {
-            // Frame counter
+            // Frame counter: restart the sequence (the 3-4 cycle hardware
+            // delay is not modelled). 5-step mode clocks everything at once.
             a->frame_mode = (data & 0x80) ? 1 : 0;
             a->irq_inhibit = (data & 0x40) != 0;
-            a->cpu_cycle_mod = 0; // reset sequence timing
+            if (a->irq_inhibit) a->frame_irq = false;
+            a->seq_origin = a->cycle;
+            a->seq_step = 0;
+            a->seq_next = a->seq_origin + (uint64_t)FRAME_SEQ[a->frame_mode][0].cycle;
+            if (a->frame_mode == 1) {
+                apu_quarter_frame(a);
+                apu_half_frame(a);
+            }
             break;
         }
         default:
             break;
     }
+    apu_update_output(a);
 }
 
-uint8_t apu_read(APU *a, uint16_t addr) {
+static uint8_t core_read(ApuCore *a, uint64_t cpu_cycle, uint16_t addr) {
     if (!a) return 0;
+    core_run_until(a, cpu_cycle);
     if (addr == 0x4015) {
         uint8_t st = 0;
-        if (a->enabled && a->p1_length) st |= 0x01;
-        if (a->tri_enabled && a->tri_length) st |= 0x04;
-        if (a->noise_enabled && a->noise_length) st |= 0x08;
-        if (a->dmc_enabled && a->dmc_remaining) st |= 0x10;
+        if (a->pulse[0].length) st |= 0x01;
+        if (a->pulse[1].length) st |= 0x02;
+        if (a->tri_length) st |= 0x04;
+        if (a->noise_length) st |= 0x08;
+        if (a->dmc_remaining) st |= 0x10;
         if (a->frame_irq) st |= 0x40;
         if (a->dmc_irq_flag) st |= 0x80;
-        // Clear frame IRQ and DMC IRQ on read
+        // Reading clears the frame IRQ flag (DMC IRQ is cleared via $4015 write)
         a->frame_irq = false;
-        a->dmc_irq_flag = false;
         return st;
     }
     return 0;
 }
 
-static void apu_quarter_frame(APU *a) {
-    // Envelope tick (approx): decay towards 0, loop if set
-    // Pulse 1 envelope
-    if (a->p1_env_start) {
-        a->p1_env_start = false;
-        a->p1_env_decay = 15;
-        a->p1_env_div = a->p1_env_period;
-    } else {
-        if (a->p1_env_div > 0) a->p1_env_div--; else {
-            a->p1_env_div = a->p1_env_period;
-            if (a->p1_env_decay > 0) a->p1_env_decay--; else if (a->p1_env_loop) a->p1_env_decay = 15;
-        }
-    }
-    a->volume = ((float)(a->p1_env_const ? a->p1_env_period : a->p1_env_decay) / 15.0f) * 0.2f;
-    // Noise envelope
-    if (a->noise_env_start) {
-        a->noise_env_start = false;
-        a->noise_env_decay = 15;
-        a->noise_env_div = a->noise_env_period;
-    } else {
-        if (a->noise_env_div > 0) a->noise_env_div--; else {
-            a->noise_env_div = a->noise_env_period;
-            if (a->noise_env_decay > 0) a->noise_env_decay--; else if (a->noise_env_loop) a->noise_env_decay = 15;
-        }
+// Fire the sequencer entry due at a->cycle and schedule the next one
+static void apu_frame_step(ApuCore *a) {
+    const FrameStep *st = &FRAME_SEQ[a->frame_mode][a->seq_step];
+    if (st->actions & SEQ_QUARTER) apu_quarter_frame(a);
+    if (st->actions & SEQ_HALF) apu_half_frame(a);
+    if ((st->actions & SEQ_IRQ) && !a->irq_inhibit) a->frame_irq = true;
+    if (++a->seq_step == FRAME_SEQ_LEN[a->frame_mode]) {
+        a->seq_step = 0;
+        a->seq_origin += (uint64_t)FRAME_SEQ_PERIOD[a->frame_mode];
     }
-    a->noise_volume = ((float)(a->noise_env_const ? a->noise_env_period : a->noise_env_decay) / 15.0f) * 0.2f;
-    // Triangle linear counter reload if control flag set
-    if (a->tri_control) {
-        a->tri_linear_counter = a->tri_linear_reload;
-    } else if (a->tri_linear_counter > 0) {
-        a->tri_linear_counter--;
+    a->seq_next = a->seq_origin + (uint64_t)FRAME_SEQ[a->frame_mode][a->seq_step].cycle;
+    apu_update_output(a);
+}
+
+static void core_run_until(ApuCore *a, uint64_t cpu_cycle) {
+    if (!a) return;
+    while (a->cycle < cpu_cycle) {
+        // Synthesize up to the next sequencer entry, then apply it at its exact cycle
+        uint64_t stop = cpu_cycle < a->seq_next ? cpu_cycle : a->seq_next;
+        apu_run(a, (int)(stop - a->cycle));
+        a->cycle = stop;
+        if (stop == a->seq_next) apu_frame_step(a);
+        if (a->frame_time >= APU_MAX_FRAME_CYCLES) core_end_frame(a);
     }
 }
 
-static void apu_half_frame(APU *a) {
-    // Length counters
-    if (!a->p1_env_loop && a->p1_length > 0) a->p1_length--;
-    if (!a->tri_control && a->tri_length > 0) a->tri_length--;
-    if (!a->noise_env_loop && a->noise_length > 0) a->noise_length--;
+static uint64_t core_next_event(const ApuCore *a) {
+    if (!a) return UINT64_MAX;
+    uint64_t next = UINT64_MAX;
+    if (a->frame_mode == 0 && !a->irq_inhibit && !a->frame_irq) {
+        next = a->seq_origin + FRAME_SEQ_IRQ_CYCLE;
+        if (next < a->seq_next) next += (uint64_t)FRAME_SEQ_PERIOD[0];
+    }
+    if (a->dmc_dma_pending) return a->cycle;
+    if (a->dmc_buffer_full && a->dmc_remaining > 0 && (a->dmc_enabled || !a->dmc_silence)) {
+        // The shift register takes the buffered byte when it next empties,
+        // which requests the following byte (and may end the sample)
+        int period = DMC_PERIODS[a->dmc_rate_index & 0x0F];
+        int bits = a->dmc_bits_remaining ? a->dmc_bits_remaining : 8;
+        uint64_t fetch = a->cycle + (uint64_t)a->dmc_ctr + (uint64_t)(bits - 1) * (uint64_t)period;
+        if (fetch < next) next = fetch;
+    }
+    return next;
 }
 
-void apu_tick_cpu_cycles(APU *a, int cpu_cycles) {
+static void core_end_frame(ApuCore *a) {
     if (!a) return;
-    // 4-step sequence clocks at 3729, 7457, 11186, 14916 CPU cycles
-    static const int step_times[4] = {3729, 7457, 11186, 14916};
-    a->cpu_cycle_mod += cpu_cycles;
-    while (1) {
-        int idx = 0;
-        while (idx < 4 && a->cpu_cycle_mod >= step_times[idx]) idx++;
-        if (idx == 0) break;
-        // Consume whole sequence period if exceeded end
-        if (a->cpu_cycle_mod >= step_times[3]) {
-            a->cpu_cycle_mod -= step_times[3];
-            // Step 3: quarter + half
-            apu_quarter_frame(a);
-            apu_half_frame(a);
-            if (!a->irq_inhibit && a->frame_mode == 0) a->frame_irq = true;
-        } else {
-            // Handle intermediate steps up to idx
-            for (int i = 0; i < idx; ++i) {
-                apu_quarter_frame(a);
-                if (i == 1 || i == 3) apu_half_frame(a);
-            }
-            a->cpu_cycle_mod = 0;
+    if (a->sink) {
+        blip_end_frame(&a->blip, a->frame_time);
+        int n = blip_read_samples(&a->blip, a->out_buf, a->blip.size);
+        audio_sink_write(a->sink, a->out_buf, n);
+    }
+    a->frame_time = 0;
+}
+
+static void core_set_rate_ratio(ApuCore *a, double ratio) {
+    if (ratio == a->rate_ratio) return;
+    // Only called between frames, so the step buffer's frame origin is intact
+    a->rate_ratio = ratio;
+    blip_set_rates(&a->blip, APU_CPU_CLOCK, (double)a->sample_rate * ratio);
+}
+
+static void core_free_output(ApuCore *a) {
+    blip_free(&a->blip);
+    free(a->out_buf);
+    a->out_buf = NULL;
+}
+
+// Save states cover the emulated part of a core, pulse through dmc_ctr; the
+// output side (level, step buffer, sink) belongs to whoever owns the core
+#define APU_STATE_BEGIN offsetof(ApuCore, pulse)
+#define APU_STATE_END offsetof(ApuCore, amp)
+#define APU_STATE_SIZE (APU_STATE_END - APU_STATE_BEGIN)
+
+// Replay one queued event on a synthesizing core
+static void core_apply(ApuCore *a, const ApuWrite *w) {
+    switch (w->addr) {
+        case APU_WRITE_END_FRAME:
+            core_run_until(a, w->cycle);
+            core_end_frame(a);
+            break;
+        case APU_WRITE_DMC_BYTE:
+            core_run_until(a, w->cycle);
+            core_dma_complete(a, w->value);
+            break;
+        default:
+            core_write(a, w->cycle, w->addr, w->value);
+            break;
+    }
+}
+
+// The public APU: the timing core answers the CPU, the synth core renders on
+// its own thread from the event queue, so waveform synthesis and resampling
+// stay off the emulation thread.
+struct APU {
+    ApuCore core;
+    ApuCore *synth;   // present while a sink is attached
+    BlipQuality quality;
+    ApuQueue queue;
+    pthread_t thread;
+    bool running;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool quit;        // guarded by lock
+    _Atomic double rate_ratio;
+    bool written;     // any register write since power-on
+    bool muted;       // speculative run: events stay off the queue and log
+    FILE *record;
+    uint64_t record_cycle;
+    // State handed to the render thread by apu_load_state; pending until the
+    // matching APU_WRITE_LOAD_STATE event has been applied
+    uint8_t resync[APU_STATE_SIZE];
+    _Atomic bool resync_pending;
+};
+
+static void *apu_render_main(void *arg) {
+    APU *a = (APU*)arg;
+    ApuWrite batch[APU_RENDER_BATCH];
+    for (;;) {
+        uint32_t n = apu_queue_pop(&a->queue, batch, APU_RENDER_BATCH);
+        if (n == 0) {
+            pthread_mutex_lock(&a->lock);
+            while (apu_queue_empty(&a->queue) && !a->quit) pthread_cond_wait(&a->wake, &a->lock);
+            bool done = a->quit && apu_queue_empty(&a->queue);
+            pthread_mutex_unlock(&a->lock);
+            if (done) break;
+            continue;
         }
-        // In 5-step mode, behavior differs; we approximate to 4-step without IRQ
-        if (a->frame_mode == 1) {
-            // No IRQ; handled via irq_inhibit flag
+        for (uint32_t i = 0; i < n; ++i) {
+            if (batch[i].addr == APU_WRITE_LOAD_STATE) {
+                // Jump the synth to the loaded registers; its output level
+                // and frame position carry on, so the sink sees one step
+                memcpy((uint8_t*)a->synth + APU_STATE_BEGIN, a->resync, APU_STATE_SIZE);
+                apu_update_output(a->synth);
+                atomic_store_explicit(&a->resync_pending, false, memory_order_release);
+                continue;
+            }
+            core_apply(a->synth, &batch[i]);
+            if (batch[i].addr == APU_WRITE_END_FRAME)
+                core_set_rate_ratio(a->synth, atomic_load_explicit(&a->rate_ratio, memory_order_relaxed));
         }
     }
+    return NULL;
+}
 
-    // DMC stepping: process bits at DMC rate
-    if (a->dmc_enabled && a->dmc_inc > 0.0) {
-        a->dmc_phase += a->dmc_inc * (double)cpu_cycles;
-        while (a->dmc_phase >= 1.0) {
-            a->dmc_phase -= 1.0;
-            if (a->dmc_bits_remaining == 0) {
-                if (!a->dmc_buffer_full && a->bus && a->dmc_remaining > 0) {
-                    a->dmc_buffer = bus_cpu_read(a->bus, a->dmc_cur_addr);
-                    a->dmc_buffer_full = true;
-                    a->dmc_cur_addr++;
-                    if (a->dmc_cur_addr == 0x0000) a->dmc_cur_addr = 0x8000; // wrap
-                    a->dmc_remaining--;
-                    if (a->dmc_remaining == 0 && a->dmc_irq_enable) a->dmc_irq_flag = true;
-                }
-                if (a->dmc_buffer_full) {
-                    a->dmc_shift_reg = a->dmc_buffer;
-                    a->dmc_bits_remaining = 8;
-                    a->dmc_buffer_full = false;
-                } else {
-                    // No sample data: hold shift reg at 1s
-                    a->dmc_shift_reg = 0xFF;
-                    a->dmc_bits_remaining = 8;
-                }
-            }
-            // Output bit adjusts 7-bit output towards max/min by 2
-            if (a->dmc_shift_reg & 1) {
-                if (a->dmc_output <= 125) a->dmc_output += 2;
-            } else {
-                if (a->dmc_output >= 2) a->dmc_output -= 2;
-            }
-            a->dmc_shift_reg >>= 1;
-            if (a->dmc_bits_remaining) a->dmc_bits_remaining--;
+static void apu_wake_renderer(APU *a) {
+    pthread_mutex_lock(&a->lock);
+    pthread_cond_signal(&a->wake);
+    pthread_mutex_unlock(&a->lock);
+}
+
+static bool apu_start_renderer(APU *a) {
+    a->quit = false;
+    a->running = pthread_create(&a->thread, NULL, apu_render_main, a) == 0;
+    return a->running;
+}
+
+// Drain the queue and join; the synth core is then safe to touch
+static void apu_stop_renderer(APU *a) {
+    if (!a->running) return;
+    pthread_mutex_lock(&a->lock);
+    a->quit = true;
+    pthread_cond_signal(&a->wake);
+    pthread_mutex_unlock(&a->lock);
+    pthread_join(a->thread, NULL);
+    a->running = false;
+}
+
+static void apu_emit(APU *a, uint64_t cycle, uint16_t addr, uint8_t value) {
+    if (a->muted) return;
+    ApuWrite w = { cycle, addr, value };
+    if (a->record && !apu_log_put(a->record, &a->record_cycle, &w)) apu_record_stop(a);
+    if (!a->running) return;
+    while (!apu_queue_push(&a->queue, &w)) {
+        // Renderer is behind (or asleep mid-frame): kick it and wait for room
+        apu_wake_renderer(a);
+        sched_yield();
+    }
+    if (addr == APU_WRITE_END_FRAME) apu_wake_renderer(a);
+}
+
+bool apu_init(APU **out) {
+    pthread_once(&noise_tables_once, noise_build_tables);
+    APU *a = (APU*)calloc(1, sizeof(APU));
+    if (!a) { *out = NULL; return false; }
+    core_power_on(&a->core);
+    a->quality = BLIP_QUALITY_MEDIUM;
+    atomic_init(&a->rate_ratio, 1.0);
+    atomic_init(&a->resync_pending, false);
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->wake, NULL);
+    *out = a;
+    return true;
+}
+
+bool apu_clone(const APU *src, APU **out) {
+    *out = NULL;
+    if (!src) return false;
+    APU *a = (APU*)calloc(1, sizeof(APU));
+    if (!a) return false;
+    a->core = src->core;
+    a->quality = src->quality;
+    a->written = src->written;
+    atomic_init(&a->rate_ratio, 1.0);
+    atomic_init(&a->resync_pending, false);
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->wake, NULL);
+    *out = a;
+    return true;
+}
+
+void apu_shutdown(APU **pa) {
+    if (!pa || !*pa) return;
+    APU *a = *pa; *pa = NULL;
+    apu_stop_renderer(a);
+    apu_record_stop(a);
+    if (a->synth) { core_free_output(a->synth); free(a->synth); }
+    apu_queue_free(&a->queue);
+    pthread_cond_destroy(&a->wake);
+    pthread_mutex_destroy(&a->lock);
+    free(a);
+}
+
+bool apu_set_sink(APU *a, AudioSink *sink) {
+    if (!a) return false;
+    apu_stop_renderer(a);
+    if (!sink) {
+        if (a->synth) { core_free_output(a->synth); free(a->synth); a->synth = NULL; }
+        return true;
+    }
+    // The queue only exists while there is a renderer to feed
+    if (!a->queue.data && !apu_queue_init(&a->queue, APU_QUEUE_CAPACITY)) return false;
+    if (!a->synth) {
+        // Start synthesis from the current register state
+        ApuCore *s = (ApuCore*)malloc(sizeof(ApuCore));
+        if (!s) return false;
+        *s = a->core;
+        s->synth = true;
+        s->blip = (Blip){0};
+        s->out_buf = NULL;
+        s->frame_time = 0;
+        s->quality = a->quality;
+        s->rate_ratio = 1.0;
+        a->synth = s;
+    }
+    ApuCore *s = a->synth;
+    if (!core_alloc_output(s, sink->sample_rate)) {
+        core_free_output(s); free(s); a->synth = NULL;
+        return false;
+    }
+    s->sink = sink;
+    // Restart the output level from the current channel state
+    s->amp = 0.0f;
+    apu_update_output(s);
+    if (!apu_start_renderer(a)) {
+        core_free_output(s); free(s); a->synth = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool apu_set_resampler_quality(APU *a, BlipQuality quality) {
+    if (!a) return false;
+    if (quality == a->quality) return true;
+    BlipQuality prev = a->quality;
+    a->quality = quality;
+    ApuCore *s = a->synth;
+    if (!s) return true;
+    apu_stop_renderer(a);
+    s->quality = quality;
+    bool ok = core_alloc_output(s, s->sample_rate);
+    if (!ok) {
+        a->quality = s->quality = prev;
+        core_alloc_output(s, s->sample_rate);
+    }
+    s->amp = 0.0f;
+    apu_update_output(s);
+    apu_start_renderer(a);
+    return ok;
+}
+
+void apu_write(APU *a, uint64_t cpu_cycle, uint16_t addr, uint8_t data) {
+    if (!a) return;
+    core_write(&a->core, cpu_cycle, addr, data);
+    a->written = true;
+    apu_emit(a, a->core.cycle, addr, data);
+}
+
+uint8_t apu_read(APU *a, uint64_t cpu_cycle, uint16_t addr) {
+    return a ? core_read(&a->core, cpu_cycle, addr) : 0;
+}
+
+void apu_run_until(APU *a, uint64_t cpu_cycle) {
+    if (a) core_run_until(&a->core, cpu_cycle);
+}
+
+uint64_t apu_next_event_cycle(const APU *a) {
+    return a ? core_next_event(&a->core) : UINT64_MAX;
+}
+
+bool apu_dmc_dma_pending(const APU *a, uint16_t *addr) {
+    if (!a || !a->core.dmc_dma_pending) return false;
+    *addr = a->core.dmc_cur_addr;
+    return true;
+}
+
+void apu_dmc_dma_complete(APU *a, uint8_t value) {
+    if (!a || !a->core.dmc_dma_pending) return;
+    core_dma_complete(&a->core, value);
+    apu_emit(a, a->core.cycle, APU_WRITE_DMC_BYTE, value);
+}
+
+void apu_end_frame(APU *a) {
+    if (!a) return;
+    core_end_frame(&a->core);
+    apu_emit(a, a->core.cycle, APU_WRITE_END_FRAME, 0);
+}
+
+void apu_set_rate_ratio(APU *a, double ratio) {
+    if (a) atomic_store_explicit(&a->rate_ratio, ratio, memory_order_relaxed);
+}
+
+void apu_set_muted(APU *a, bool muted) {
+    if (a) a->muted = muted;
+}
+
+size_t apu_state_size(void) {
+    return APU_STATE_SIZE;
+}
+
+size_t apu_save_state(const APU *a, void *buf) {
+    if (!a) return 0;
+    memcpy(buf, (const uint8_t*)&a->core + APU_STATE_BEGIN, APU_STATE_SIZE);
+    return APU_STATE_SIZE;
+}
+
+bool apu_load_state(APU *a, const void *buf, size_t len) {
+    if (!a || len != APU_STATE_SIZE) return false;
+    if (a->muted) {
+        // Rolling back a speculative run: the synth is still where it was
+        memcpy((uint8_t*)&a->core + APU_STATE_BEGIN, buf, APU_STATE_SIZE);
+        return true;
+    }
+    // A log replays from power-on and cannot express a jump
+    apu_record_stop(a);
+    memcpy((uint8_t*)&a->core + APU_STATE_BEGIN, buf, APU_STATE_SIZE);
+    a->written = true;
+    if (a->running) {
+        // One hand-off slot: wait for the renderer to take the previous one
+        while (atomic_load_explicit(&a->resync_pending, memory_order_acquire)) {
+            apu_wake_renderer(a);
+            sched_yield();
         }
+        memcpy(a->resync, buf, APU_STATE_SIZE);
+        atomic_store_explicit(&a->resync_pending, true, memory_order_release);
+        apu_emit(a, a->core.cycle, APU_WRITE_LOAD_STATE, 0);
+    } else if (a->synth) {
+        memcpy((uint8_t*)a->synth + APU_STATE_BEGIN, buf, APU_STATE_SIZE);
+        apu_update_output(a->synth);
     }
+    return true;
 }
 
-#include <stdbool.h>
-bool apu_frame_irq_pending(APU *a) { return a ? a->frame_irq : false; }
-bool apu_dmc_irq_pending(APU *a) { return a ? a->dmc_irq_flag : false; }
+bool apu_frame_irq_pending(APU *a) { return a ? a->core.frame_irq : false; }
+bool apu_dmc_irq_pending(APU *a) { return a ? a->core.dmc_irq_flag : false; }
 
-#else
+bool apu_record_start(APU *a, const char *path) {
+    if (!a || a->written) return false;
+    apu_record_stop(a);
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    if (!apu_log_write_header(f)) { fclose(f); return false; }
+    a->record = f;
+    a->record_cycle = 0;
+    return true;
+}
 
-// Headless stubs without SDL2
-struct APU { int dummy; };
-bool apu_init(APU **out) { *out = NULL; return false; }
-void apu_shutdown(APU **out) { (void)out; }
-void apu_write(APU *a, uint16_t addr, uint8_t data) { (void)a; (void)addr; (void)data; }
+bool apu_record_stop(APU *a) {
+    if (!a || !a->record) return false;
+    bool ok = fclose(a->record) == 0;
+    a->record = NULL;
+    return ok;
+}
 
-#endif
+long apu_log_render(const char *path, AudioSink *sink, BlipQuality quality) {
+    if (!sink) return -1;
+    pthread_once(&noise_tables_once, noise_build_tables);
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    if (!apu_log_check_header(f)) { fclose(f); return -2; }
+    ApuCore *s = (ApuCore*)malloc(sizeof(ApuCore));
+    if (!s) { fclose(f); return -1; }
+    core_power_on(s);
+    s->synth = true;
+    s->quality = quality;
+    if (!core_alloc_output(s, sink->sample_rate)) { free(s); fclose(f); return -1; }
+    s->sink = sink;
+    apu_update_output(s);
+    long frames = 0;
+    uint64_t cycle = 0;
+    ApuWrite w;
+    while (apu_log_get(f, &cycle, &w)) {
+        core_apply(s, &w);
+        if (w.addr == APU_WRITE_END_FRAME) ++frames;
+    }
+    core_end_frame(s);
+    core_free_output(s);
+    free(s);
+    fclose(f);
+    return frames;
+}
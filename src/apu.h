@@ -1,23 +1,89 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include "bus.h"
+#include "audio.h"
+#include "blip.h"
 
 typedef struct APU APU; // opaque
 
+// Pure emulation core: no audio device is opened. Output goes to whatever
+// sink is attached with apu_set_sink.
+//
+// The APU is split in two. The calls below run a timing-only copy on the
+// caller's thread (status, length counters, frame and DMC IRQs, DMC DMA) and
+// log every register write, DMA byte and frame end as a timestamped event.
+// While a sink is attached a render thread replays those events into a
+// synthesizing copy, so waveform generation and resampling happen off the
+// emulation thread.
 bool apu_init(APU **out);
 void apu_shutdown(APU **out);
+// New APU in the same emulated state as src, with no sink and not recording
+bool apu_clone(const APU *src, APU **out);
 
-// Very minimal square wave on pulse 1 controlled by $4000, $4002, $4003, $4015
-void apu_write(APU *a, uint16_t addr, uint8_t data);
-uint8_t apu_read(APU *a, uint16_t addr);
+// Attach (or detach with NULL) the sink that receives samples at
+// apu_end_frame; synthesis switches to the sink's sample rate. The sink is
+// borrowed and must outlive the attachment; detaching drains pending events
+// into it first.
+bool apu_set_sink(APU *a, AudioSink *sink);
 
-// Tick APU frame sequencer and counters by CPU cycles
-void apu_tick_cpu_cycles(APU *a, int cpu_cycles);
+// Trade resampling quality for CPU; pending output is dropped. Default is
+// BLIP_QUALITY_MEDIUM.
+bool apu_set_resampler_quality(APU *a, BlipQuality quality);
 
-// Connect bus for DMC memory fetches
-void apu_connect_bus(APU *a, Bus *bus);
+// Register access at an absolute CPU cycle; the APU catches up to it first
+void apu_write(APU *a, uint64_t cpu_cycle, uint16_t addr, uint8_t data);
+uint8_t apu_read(APU *a, uint64_t cpu_cycle, uint16_t addr);
+
+// Catch channels, frame sequencer and DMC up to an absolute CPU cycle.
+// Sequencer steps land on their exact cycle; waveform changes are recorded
+// into a band-limited step buffer. Running lazily is fine: nothing here is
+// observable by the CPU except through registers and the IRQ flags.
+void apu_run_until(APU *a, uint64_t cpu_cycle);
+
+// Earliest CPU cycle at which an IRQ flag may be raised or a DMC DMA is due
+// (UINT64_MAX if none). The scheduler only needs to call apu_run_until when
+// this passes.
+uint64_t apu_next_event_cycle(const APU *a);
+
+// DMC sample DMA: the APU never touches memory itself. When a request is
+// pending, the CPU side reads the byte at *addr (stalling the CPU) and hands
+// it back.
+bool apu_dmc_dma_pending(const APU *a, uint16_t *addr);
+void apu_dmc_dma_complete(APU *a, uint8_t value);
+
+// Close the audio frame: everything synthesized up to the last
+// apu_run_until is resampled and passed to the sink (asynchronously, on the
+// render thread). Call once per video frame.
+void apu_end_frame(APU *a);
+
+// Scale samples produced per emulated second (dynamic rate control). Call
+// between frames.
+void apu_set_rate_ratio(APU *a, double ratio);
+
+// Speculative execution (run-ahead): while muted, the timing core runs as
+// usual but nothing reaches the synthesizer or the log. Loading a state
+// saved just before muting, while still muted, rolls back the timing core
+// only: the synthesizer and log never saw the speculative frames.
+void apu_set_muted(APU *a, bool muted);
+
+// Save states: the timing core's registers, counters and sequencer position
+// (the resampler and sink are not part of it). Loading also moves the
+// synthesizer, if any, to the new state through the event queue, and stops
+// an APU log recording.
+size_t apu_state_size(void);
+size_t apu_save_state(const APU *a, void *buf);
+bool apu_load_state(APU *a, const void *buf, size_t len);
 
 // Query IRQ flags (do not clear; reading $4015 clears on hardware)
 bool apu_frame_irq_pending(APU *a);
 bool apu_dmc_irq_pending(APU *a);
+
+// Record the event stream to a file (see apu_queue.h). The log replays from
+// power-on, so recording must start before the first register write.
+bool apu_record_start(APU *a, const char *path);
+bool apu_record_stop(APU *a);
+
+// Render a recorded log into a sink on the calling thread. Returns the
+// number of frames rendered, -1 on I/O error, -2 if the file is not a log.
+long apu_log_render(const char *path, AudioSink *sink, BlipQuality quality);
@@ -0,0 +1,88 @@
+#include "apu_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char APU_LOG_MAGIC[8] = "NESAPU1";
+
+bool apu_queue_init(ApuQueue *q, uint32_t capacity) {
+    memset(q, 0, sizeof(*q));
+    uint32_t cap = 64;
+    while (cap < capacity && cap < (1u << 24)) cap <<= 1;
+    q->data = (ApuWrite*)calloc(cap, sizeof(ApuWrite));
+    if (!q->data) return false;
+    q->capacity = cap;
+    q->mask = cap - 1;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return true;
+}
+
+void apu_queue_free(ApuQueue *q) {
+    if (!q) return;
+    free(q->data); q->data = NULL; q->capacity = 0; q->mask = 0;
+}
+
+bool apu_queue_push(ApuQueue *q, const ApuWrite *w) {
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (head - tail == q->capacity) return false;
+    q->data[head & q->mask] = *w;
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+
+uint32_t apu_queue_pop(ApuQueue *q, ApuWrite *dst, uint32_t max) {
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    uint32_t count = head - tail;
+    if (count > max) count = max;
+    for (uint32_t i = 0; i < count; ++i) dst[i] = q->data[(tail + i) & q->mask];
+    atomic_store_explicit(&q->tail, tail + count, memory_order_release);
+    return count;
+}
+
+bool apu_queue_empty(const ApuQueue *q) {
+    return atomic_load_explicit(&q->head, memory_order_acquire) ==
+           atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+bool apu_log_write_header(FILE *f) {
+    return fwrite(APU_LOG_MAGIC, 1, sizeof(APU_LOG_MAGIC), f) == sizeof(APU_LOG_MAGIC);
+}
+
+bool apu_log_check_header(FILE *f) {
+    char magic[8];
+    return fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, APU_LOG_MAGIC, sizeof(magic)) == 0;
+}
+
+bool apu_log_put(FILE *f, uint64_t *last_cycle, const ApuWrite *w) {
+    uint8_t buf[12];
+    int n = 0;
+    uint64_t delta = w->cycle - *last_cycle;
+    do {
+        uint8_t b = (uint8_t)(delta & 0x7F);
+        delta >>= 7;
+        buf[n++] = (uint8_t)(delta ? (b | 0x80) : b);
+    } while (delta);
+    buf[n++] = (uint8_t)(w->addr - 0x4000);
+    buf[n++] = w->value;
+    *last_cycle = w->cycle;
+    return fwrite(buf, 1, (size_t)n, f) == (size_t)n;
+}
+
+bool apu_log_get(FILE *f, uint64_t *last_cycle, ApuWrite *w) {
+    uint64_t delta = 0;
+    int shift = 0, c;
+    do {
+        if ((c = fgetc(f)) == EOF || shift > 63) return false;
+        delta |= (uint64_t)(c & 0x7F) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    int reg = fgetc(f), value = fgetc(f);
+    if (reg == EOF || value == EOF) return false;
+    *last_cycle += delta;
+    w->cycle = *last_cycle;
+    w->addr = (uint16_t)(0x4000 + reg);
+    w->value = (uint8_t)value;
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+// Timestamped APU input: every register write, DMC DMA byte and audio frame
+// boundary, in CPU-cycle order. This is all the synthesizer needs, so it is
+// both the hand-off from the CPU thread to the render thread and a compact
+// recording of a session's audio.
+typedef struct {
+    uint64_t cycle;   // absolute CPU cycle
+    uint16_t addr;    // $4000-$4017, or one of the pseudo registers below
+    uint8_t value;
+} ApuWrite;
+
+#define APU_WRITE_DMC_BYTE  0x4018 // sample byte delivered by DMA
+#define APU_WRITE_END_FRAME 0x4019 // close the audio frame at this cycle
+#define APU_WRITE_LOAD_STATE 0x401A // a save state was loaded (queue only, never logged)
+
+// Single-producer/single-consumer ring of ApuWrite; no locks
+typedef struct {
+    ApuWrite *data;
+    uint32_t capacity;              // power of two
+    uint32_t mask;
+    _Atomic uint32_t head;          // next write index (producer-owned)
+    _Atomic uint32_t tail;          // next read index (consumer-owned)
+} ApuQueue;
+
+// Capacity is rounded up to a power of two
+bool apu_queue_init(ApuQueue *q, uint32_t capacity);
+void apu_queue_free(ApuQueue *q);
+// Producer side: false if the queue is full
+bool apu_queue_push(ApuQueue *q, const ApuWrite *w);
+// Consumer side: returns entries copied (0 if empty)
+uint32_t apu_queue_pop(ApuQueue *q, ApuWrite *dst, uint32_t max);
+bool apu_queue_empty(const ApuQueue *q);
+
+// Recording: "NESAPU1" header, then per entry a LEB128 cycle delta, the
+// register offset from $4000 and the value (usually 3 bytes)
+bool apu_log_write_header(FILE *f);
+bool apu_log_check_header(FILE *f);
+// *last_cycle carries the delta base between calls; start it at 0
+bool apu_log_put(FILE *f, uint64_t *last_cycle, const ApuWrite *w);
+bool apu_log_get(FILE *f, uint64_t *last_cycle, ApuWrite *w);
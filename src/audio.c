@@ -0,0 +1,119 @@
+#include "audio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void audio_sink_write(AudioSink *s, const float *samples, int count) {
+    if (s && count > 0) s->write(s, samples, count);
+}
+
+void audio_sink_close(AudioSink **ps) {
+    if (!ps || !*ps) return;
+    AudioSink *s = *ps; *ps = NULL;
+    s->close(s);
+}
+
+bool audio_sink_stats(AudioSink *s, AudioRingStats *out, bool reset_minmax) {
+    if (!s || !s->stats) { memset(out, 0, sizeof(*out)); return false; }
+    s->stats(s, out, reset_minmax);
+    return true;
+}
+
+static inline int16_t f32_to_s16_one(float v) {
+    v *= 32767.0f;
+    v = v > 32767.0f ? 32767.0f : v;
+    v = v < -32768.0f ? -32768.0f : v;
+    return (int16_t)v;
+}
+
+// Clamp and convert a block to 16-bit PCM. The fixed-width inner loop is
+// branch-free so it compiles to packed min/max/convert even at -O2; byte
+// order is fixed up separately.
+static void f32_to_s16(const float *restrict in, int16_t *restrict out, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        for (int j = 0; j < 8; ++j) out[i + j] = f32_to_s16_one(in[i + j]);
+    for (; i < count; ++i) out[i] = f32_to_s16_one(in[i]);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (i = 0; i < count; ++i) out[i] = (int16_t)(((uint16_t)out[i] >> 8) | ((uint16_t)out[i] << 8));
+#endif
+}
+
+// ---- File-backed sinks (WAV and raw PCM) ----
+
+typedef struct {
+    AudioSink base;
+    FILE *f;
+    bool wav;            // write/patch a RIFF header
+    bool owns_file;      // false for stdout
+    uint32_t data_bytes;
+    int16_t scratch[4096]; // little-endian PCM
+} FileSink;
+
+static void put_le32(uint8_t *p, uint32_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24); }
+static void put_le16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+
+static void wav_header(uint8_t h[44], int sample_rate, uint32_t data_bytes) {
+    memcpy(h, "RIFF", 4); put_le32(h + 4, 36 + data_bytes);
+    memcpy(h + 8, "WAVEfmt ", 8); put_le32(h + 16, 16);
+    put_le16(h + 20, 1);                          // PCM
+    put_le16(h + 22, 1);                          // mono
+    put_le32(h + 24, (uint32_t)sample_rate);
+    put_le32(h + 28, (uint32_t)sample_rate * 2);  // byte rate
+    put_le16(h + 32, 2);                          // block align
+    put_le16(h + 34, 16);                         // bits per sample
+    memcpy(h + 36, "data", 4); put_le32(h + 40, data_bytes);
+}
+
+static void file_sink_write(AudioSink *s, const float *samples, int count) {
+    FileSink *fs = (FileSink*)s;
+    while (count > 0) {
+        int n = count < 4096 ? count : 4096;
+        f32_to_s16(samples, fs->scratch, n);
+        fs->data_bytes += (uint32_t)fwrite(fs->scratch, 1, (size_t)n * 2, fs->f);
+        samples += n; count -= n;
+    }
+}
+
+static void file_sink_close(AudioSink *s) {
+    FileSink *fs = (FileSink*)s;
+    if (fs->wav && fseek(fs->f, 0, SEEK_SET) == 0) {
+        uint8_t h[44];
+        wav_header(h, s->sample_rate, fs->data_bytes);
+        fwrite(h, 1, sizeof(h), fs->f);
+    }
+    if (fs->owns_file) fclose(fs->f); else fflush(fs->f);
+    free(fs);
+}
+
+static AudioSink *file_sink_open(const char *path, int sample_rate, bool wav) {
+    if (!path || sample_rate <= 0) return NULL;
+    FileSink *fs = (FileSink*)calloc(1, sizeof(FileSink));
+    if (!fs) return NULL;
+    if (!wav && strcmp(path, "-") == 0) {
+        fs->f = stdout; fs->owns_file = false;
+    } else {
+        fs->f = fopen(path, "wb"); fs->owns_file = true;
+    }
+    if (!fs->f) { free(fs); return NULL; }
+    fs->wav = wav;
+    fs->base.write = file_sink_write;
+    fs->base.close = file_sink_close;
+    fs->base.stats = NULL;
+    fs->base.sample_rate = sample_rate;
+    fs->base.realtime = false;
+    if (wav) {
+        uint8_t h[44];
+        wav_header(h, sample_rate, 0);
+        fwrite(h, 1, sizeof(h), fs->f);
+    }
+    return &fs->base;
+}
+
+AudioSink *audio_sink_wav_open(const char *path, int sample_rate) {
+    return file_sink_open(path, sample_rate, true);
+}
+
+AudioSink *audio_sink_raw_open(const char *path, int sample_rate) {
+    return file_sink_open(path, sample_rate, false);
+}
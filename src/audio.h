@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "audio_ring.h"
+
+// Destination for mono float samples produced by the APU once per frame.
+typedef struct AudioSink AudioSink;
+struct AudioSink {
+    void (*write)(AudioSink *s, const float *samples, int count);
+    void (*close)(AudioSink *s); // flush and free
+    // Optional: buffer telemetry for sinks that play in real time
+    void (*stats)(AudioSink *s, AudioRingStats *out, bool reset_minmax);
+    int sample_rate;
+    bool realtime; // consumes at wall-clock rate; emulation can pace on it
+};
+
+// SDL2 playback through a lock-free ring (NULL when built without SDL2)
+AudioSink *audio_sink_sdl_open(int sample_rate, uint32_t ring_samples);
+// 16-bit mono PCM .wav file; header sizes are patched on close
+AudioSink *audio_sink_wav_open(const char *path, int sample_rate);
+// Headerless 16-bit little-endian mono PCM; path "-" writes to stdout
+AudioSink *audio_sink_raw_open(const char *path, int sample_rate);
+
+void audio_sink_write(AudioSink *s, const float *samples, int count);
+void audio_sink_close(AudioSink **s);
+// Returns false (and zeroes out) if the sink has no telemetry
+bool audio_sink_stats(AudioSink *s, AudioRingStats *out, bool reset_minmax);
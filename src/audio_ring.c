@@ -0,0 +1,85 @@
+#include "audio_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool audio_ring_init(AudioRing *r, uint32_t capacity) {
+    memset(r, 0, sizeof(*r));
+    uint32_t cap = 64;
+    while (cap < capacity && cap < (1u << 24)) cap <<= 1;
+    r->data = (float*)calloc(cap, sizeof(float));
+    if (!r->data) return false;
+    r->capacity = cap;
+    r->mask = cap - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->fill_min, UINT32_MAX);
+    atomic_init(&r->fill_max, 0);
+    return true;
+}
+
+void audio_ring_free(AudioRing *r) {
+    if (!r) return;
+    free(r->data); r->data = NULL; r->capacity = 0; r->mask = 0;
+}
+
+uint32_t audio_ring_write(AudioRing *r, const float *src, uint32_t n) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint32_t space = r->capacity - (head - tail);
+    uint32_t count = n < space ? n : space;
+    uint32_t idx = head & r->mask;
+    uint32_t first = r->capacity - idx;
+    if (first > count) first = count;
+    memcpy(r->data + idx, src, first * sizeof(float));
+    memcpy(r->data, src + first, (count - first) * sizeof(float));
+    atomic_store_explicit(&r->head, head + count, memory_order_release);
+    if (count < n) {
+        atomic_fetch_add_explicit(&r->overruns, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&r->overrun_samples, n - count, memory_order_relaxed);
+    }
+    return count;
+}
+
+uint32_t audio_ring_read(AudioRing *r, float *dst, uint32_t n) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint32_t fill = head - tail;
+    if (fill < atomic_load_explicit(&r->fill_min, memory_order_relaxed)) atomic_store_explicit(&r->fill_min, fill, memory_order_relaxed);
+    if (fill > atomic_load_explicit(&r->fill_max, memory_order_relaxed)) atomic_store_explicit(&r->fill_max, fill, memory_order_relaxed);
+    uint32_t count = n < fill ? n : fill;
+    uint32_t idx = tail & r->mask;
+    uint32_t first = r->capacity - idx;
+    if (first > count) first = count;
+    memcpy(dst, r->data + idx, first * sizeof(float));
+    memcpy(dst + first, r->data, (count - first) * sizeof(float));
+    atomic_store_explicit(&r->tail, tail + count, memory_order_release);
+    if (count < n) {
+        memset(dst + count, 0, (n - count) * sizeof(float));
+        atomic_fetch_add_explicit(&r->underruns, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&r->underrun_samples, n - count, memory_order_relaxed);
+    }
+    return count;
+}
+
+uint32_t audio_ring_fill(const AudioRing *r) {
+    uint32_t head = atomic_load_explicit(&((AudioRing*)r)->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&((AudioRing*)r)->tail, memory_order_acquire);
+    return head - tail;
+}
+
+void audio_ring_stats(AudioRing *r, AudioRingStats *out, bool reset_minmax) {
+    out->capacity = r->capacity;
+    out->fill = audio_ring_fill(r);
+    out->fill_min = atomic_load_explicit(&r->fill_min, memory_order_relaxed);
+    out->fill_max = atomic_load_explicit(&r->fill_max, memory_order_relaxed);
+    if (out->fill_min == UINT32_MAX) out->fill_min = out->fill_max = out->fill; // no reads yet
+    out->underruns = atomic_load_explicit(&r->underruns, memory_order_relaxed);
+    out->underrun_samples = atomic_load_explicit(&r->underrun_samples, memory_order_relaxed);
+    out->overruns = atomic_load_explicit(&r->overruns, memory_order_relaxed);
+    out->overrun_samples = atomic_load_explicit(&r->overrun_samples, memory_order_relaxed);
+    if (reset_minmax) {
+        // Racy with the consumer by design; the window restarts at the next read
+        atomic_store_explicit(&r->fill_min, UINT32_MAX, memory_order_relaxed);
+        atomic_store_explicit(&r->fill_max, 0, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Single-producer/single-consumer ring of float samples. The emulation thread
+// writes, the audio device callback reads; neither side takes a lock.
+typedef struct {
+    float *data;
+    uint32_t capacity;              // power of two
+    uint32_t mask;
+    _Atomic uint32_t head;          // next write index (producer-owned)
+    _Atomic uint32_t tail;          // next read index (consumer-owned)
+
+    // Telemetry (each counter has a single writer)
+    _Atomic uint32_t fill_min;      // consumer: lowest fill seen at a read
+    _Atomic uint32_t fill_max;      // consumer: highest fill seen at a read
+    _Atomic uint64_t underruns;     // consumer: reads that ran dry
+    _Atomic uint64_t underrun_samples;
+    _Atomic uint64_t overruns;      // producer: writes that did not fit
+    _Atomic uint64_t overrun_samples;
+} AudioRing;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t fill;
+    uint32_t fill_min, fill_max;
+    uint64_t underruns, underrun_samples;
+    uint64_t overruns, overrun_samples;
+} AudioRingStats;
+
+// Capacity is rounded up to a power of two
+bool audio_ring_init(AudioRing *r, uint32_t capacity);
+void audio_ring_free(AudioRing *r);
+
+// Producer side: returns samples written; the rest are dropped and counted
+uint32_t audio_ring_write(AudioRing *r, const float *src, uint32_t n);
+// Consumer side: fills dst completely, padding with silence on underrun
+uint32_t audio_ring_read(AudioRing *r, float *dst, uint32_t n);
+
+uint32_t audio_ring_fill(const AudioRing *r);
+// Snapshot counters; reset_minmax restarts the fill extremes window
+void audio_ring_stats(AudioRing *r, AudioRingStats *out, bool reset_minmax);
@@ -0,0 +1,71 @@
+#include "audio.h"
+
+#ifdef HAVE_SDL2
+#include <SDL.h>
+
+typedef struct {
+    AudioSink base;
+    SDL_AudioDeviceID dev;
+    // The only state shared with the device callback
+    AudioRing ring;
+} SdlSink;
+
+// Runs on the SDL audio thread: copy out of the ring and nothing else
+static void SDLCALL audio_cb(void *ud, Uint8 *stream, int len) {
+    AudioRing *ring = (AudioRing*)ud;
+    audio_ring_read(ring, (float*)stream, (uint32_t)len / (uint32_t)sizeof(float));
+}
+
+static void sdl_sink_write(AudioSink *s, const float *samples, int count) {
+    SdlSink *ss = (SdlSink*)s;
+    audio_ring_write(&ss->ring, samples, (uint32_t)count);
+}
+
+static void sdl_sink_stats(AudioSink *s, AudioRingStats *out, bool reset_minmax) {
+    SdlSink *ss = (SdlSink*)s;
+    audio_ring_stats(&ss->ring, out, reset_minmax);
+}
+
+static void sdl_sink_close(AudioSink *s) {
+    SdlSink *ss = (SdlSink*)s;
+    if (ss->dev) {
+        SDL_PauseAudioDevice(ss->dev, 1);
+        SDL_CloseAudioDevice(ss->dev);
+    }
+    audio_ring_free(&ss->ring);
+    SDL_free(ss);
+}
+
+AudioSink *audio_sink_sdl_open(int sample_rate, uint32_t ring_samples) {
+    if (SDL_WasInit(SDL_INIT_AUDIO) == 0) {
+        if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) return NULL;
+    }
+    SdlSink *ss = (SdlSink*)SDL_calloc(1, sizeof(SdlSink));
+    if (!ss) return NULL;
+    if (!audio_ring_init(&ss->ring, ring_samples)) { SDL_free(ss); return NULL; }
+    SDL_AudioSpec want = {0}, have = {0};
+    want.freq = sample_rate;
+    want.format = AUDIO_F32;
+    want.channels = 1;
+    want.samples = 1024;
+    want.callback = audio_cb;
+    want.userdata = &ss->ring;
+    ss->dev = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (!ss->dev) { audio_ring_free(&ss->ring); SDL_free(ss); return NULL; }
+    ss->base.write = sdl_sink_write;
+    ss->base.close = sdl_sink_close;
+    ss->base.stats = sdl_sink_stats;
+    ss->base.sample_rate = have.freq;
+    ss->base.realtime = true;
+    SDL_PauseAudioDevice(ss->dev, 0);
+    return &ss->base;
+}
+
+#else
+#include <stddef.h>
+
+AudioSink *audio_sink_sdl_open(int sample_rate, uint32_t ring_samples) {
+    (void)sample_rate; (void)ring_samples; return NULL;
+}
+
+#endif
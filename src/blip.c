@@ -0,0 +1,150 @@
+#include "blip.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BLIP_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#define BLIP_FRAC_BITS 32
+#define BLIP_ONE ((uint64_t)1 << BLIP_FRAC_BITS)
+// DC blocker pole (~7 Hz corner at 44.1 kHz)
+#define BLIP_HP_POLE 0.999f
+
+static const struct {
+    int taps;
+    int phase_bits;
+    double cutoff; // passband edge as a fraction of the output rate
+} QUALITY[] = {
+    [BLIP_QUALITY_LOW]    = {  8, 5, 0.40 },
+    [BLIP_QUALITY_MEDIUM] = { 16, 6, 0.45 },
+    [BLIP_QUALITY_HIGH]   = { 32, 8, 0.47 },
+};
+
+// Portable inner loop; the fixed-width body vectorizes to SSE at -O2
+static void blip_add_generic(float *out, const float *k, int taps, float delta) {
+    for (int i = 0; i < taps; i += 8)
+        for (int j = 0; j < 8; ++j) out[i + j] += k[i + j] * delta;
+}
+
+#ifdef BLIP_HAVE_AVX2
+__attribute__((target("avx2,fma")))
+static void blip_add_avx2(float *out, const float *k, int taps, float delta) {
+    __m256 d = _mm256_set1_ps(delta);
+    for (int i = 0; i < taps; i += 8) {
+        // Kernel rows are aligned; output positions are arbitrary
+        __m256 o = _mm256_loadu_ps(out + i);
+        o = _mm256_fmadd_ps(_mm256_load_ps(k + i), d, o);
+        _mm256_storeu_ps(out + i, o);
+    }
+}
+#endif
+
+static void blip_make_kernel(Blip *b, double cutoff) {
+    // Blackman-windowed sinc impulse, one row per sub-sample phase. Each row
+    // sums to 1 so integrating a delta reproduces the full step.
+    const double pi = 3.14159265358979323846;
+    const int taps = b->taps, phases = 1 << b->phase_bits;
+    double row[BLIP_MAX_TAPS];
+    for (int p = 0; p < phases; ++p) {
+        double frac = (double)p / phases;
+        double sum = 0.0;
+        for (int k = 0; k < taps; ++k) {
+            double x = (double)k - (taps / 2 - 1) - frac;
+            double s = (x == 0.0) ? 1.0 : sin(2.0 * pi * cutoff * x) / (2.0 * pi * cutoff * x);
+            double w = 0.42 + 0.5 * cos(pi * x / (taps / 2)) + 0.08 * cos(2.0 * pi * x / (taps / 2));
+            row[k] = s * w;
+            sum += row[k];
+        }
+        for (int k = 0; k < taps; ++k) b->kernel[p * taps + k] = (float)(row[k] / sum);
+    }
+}
+
+bool blip_init(Blip *b, double clock_rate, double sample_rate, int max_samples, BlipQuality quality) {
+    memset(b, 0, sizeof(*b));
+    if ((unsigned)quality > BLIP_QUALITY_HIGH) quality = BLIP_QUALITY_MEDIUM;
+    b->taps = QUALITY[quality].taps;
+    b->phase_bits = QUALITY[quality].phase_bits;
+    b->buf = (float*)calloc((size_t)max_samples + (size_t)b->taps, sizeof(float));
+    // Row size is a multiple of 8 floats, so every row stays 32-byte aligned
+    size_t kbytes = ((size_t)1 << b->phase_bits) * (size_t)b->taps * sizeof(float);
+    b->kernel = (float*)aligned_alloc(32, kbytes);
+    if (!b->buf || !b->kernel) { blip_free(b); return false; }
+    b->size = max_samples;
+    blip_set_rates(b, clock_rate, sample_rate);
+    blip_make_kernel(b, QUALITY[quality].cutoff);
+    b->add = blip_add_generic;
+    #ifdef BLIP_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) b->add = blip_add_avx2;
+    #endif
+    return true;
+}
+
+void blip_free(Blip *b) {
+    if (!b) return;
+    free(b->buf); b->buf = NULL; b->size = 0;
+    free(b->kernel); b->kernel = NULL;
+}
+
+void blip_set_rates(Blip *b, double clock_rate, double sample_rate) {
+    b->factor = (uint64_t)(sample_rate / clock_rate * (double)BLIP_ONE + 0.5);
+}
+
+void blip_disable_simd(Blip *b) {
+    b->add = blip_add_generic;
+}
+
+const char *blip_impl_name(const Blip *b) {
+    #ifdef BLIP_HAVE_AVX2
+    if (b->add == blip_add_avx2) return "avx2";
+    #endif
+    (void)b;
+    return "generic";
+}
+
+void blip_add_delta(Blip *b, uint32_t clock_time, float delta) {
+    uint64_t fixed = (uint64_t)clock_time * b->factor + b->offset;
+    uint64_t pos = fixed >> BLIP_FRAC_BITS;
+    if (pos >= (uint64_t)b->size) return; // frame too long for buffer; drop
+    int phase = (int)((fixed >> (BLIP_FRAC_BITS - b->phase_bits)) & ((1u << b->phase_bits) - 1));
+    b->add(b->buf + pos, b->kernel + phase * b->taps, b->taps, delta);
+}
+
+void blip_end_frame(Blip *b, uint32_t clocks) {
+    b->offset += (uint64_t)clocks * b->factor;
+    uint64_t avail = b->offset >> BLIP_FRAC_BITS;
+    if (avail > (uint64_t)b->size) {
+        // Overflowed: keep what fits and resync the frame origin
+        avail = (uint64_t)b->size;
+        b->offset = avail << BLIP_FRAC_BITS;
+    }
+    b->avail = (int)avail;
+}
+
+int blip_samples_avail(const Blip *b) {
+    return b->avail;
+}
+
+int blip_read_samples(Blip *b, float *out, int count) {
+    int n = count < b->avail ? count : b->avail;
+    if (n <= 0) return 0;
+    float sum = b->integrator;
+    float hp_in = b->hp_in, hp_out = b->hp_out;
+    for (int i = 0; i < n; ++i) {
+        sum += b->buf[i];
+        float y = sum - hp_in + BLIP_HP_POLE * hp_out;
+        hp_in = sum; hp_out = y;
+        out[i] = y;
+    }
+    b->integrator = sum;
+    b->hp_in = hp_in; b->hp_out = hp_out;
+    // Shift unread samples and pending kernel tails to the front
+    int remain = b->avail - n + b->taps;
+    memmove(b->buf, b->buf + n, (size_t)remain * sizeof(float));
+    memset(b->buf + remain, 0, (size_t)n * sizeof(float));
+    b->avail -= n;
+    b->offset -= (uint64_t)n << BLIP_FRAC_BITS;
+    return n;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Band-limited step buffer: amplitude changes are added as deltas at CPU-cycle
+// timestamps and turned into output-rate samples once per frame. Each delta is
+// spread over a polyphase windowed-sinc kernel, so the CPU-clock input is
+// decimated to any output rate without aliasing.
+
+// Quality/CPU trade-off: more taps give a steeper anti-alias filter, more
+// phases give finer sub-sample timing.
+typedef enum {
+    BLIP_QUALITY_LOW,    //  8 taps,  32 phases
+    BLIP_QUALITY_MEDIUM, // 16 taps,  64 phases (default)
+    BLIP_QUALITY_HIGH    // 32 taps, 256 phases
+} BlipQuality;
+
+#define BLIP_MAX_TAPS 32
+
+typedef struct Blip Blip;
+struct Blip {
+    float *buf;             // impulse accumulation buffer (size + taps)
+    int size;               // max samples held between reads
+    uint64_t factor;        // output samples per input clock (32.32 fixed)
+    uint64_t offset;        // start of current frame in output samples (32.32 fixed)
+    int avail;              // samples ready to read
+    float integrator;       // running sum of deltas
+    float hp_in, hp_out;    // DC blocker state
+    int taps;               // kernel length, a multiple of 8
+    int phase_bits;         // log2 of kernel phases
+    float *kernel;          // [phases][taps], 32-byte aligned
+    // Inner loop: out[0..taps) += k[0..taps) * delta
+    void (*add)(float *out, const float *k, int taps, float delta);
+};
+
+bool blip_init(Blip *b, double clock_rate, double sample_rate, int max_samples, BlipQuality quality);
+void blip_free(Blip *b);
+void blip_set_rates(Blip *b, double clock_rate, double sample_rate);
+// Use the portable inner loop even where AVX2 is available (A/B comparison)
+void blip_disable_simd(Blip *b);
+// Name of the inner loop in use ("avx2" or "generic")
+const char *blip_impl_name(const Blip *b);
+
+// Add an amplitude change at clock_time (clocks since the start of the frame)
+void blip_add_delta(Blip *b, uint32_t clock_time, float delta);
+// Close the frame after `clocks` input clocks; its samples become readable
+void blip_end_frame(Blip *b, uint32_t clocks);
+int blip_samples_avail(const Blip *b);
+// Read up to count samples; returns number read
+int blip_read_samples(Blip *b, float *out, int count);
@@ -5,13 +5,54 @@
 #include "nes.h"
 #include <string.h>
 
+// OAM DMA halts the CPU for 513 cycles, plus one to align to a read cycle
+// when it starts on an odd cycle
+#define OAM_DMA_CYCLES 513
+// $4014 is written by STA/STX/STY absolute, whose write is the 4th cycle of
+// the instruction; the CPU core only counts cycles per instruction
+#define OAM_DMA_WRITE_CYCLE 3
+
 void bus_init(Bus *b, NES *nes) {
     memset(b->ram, 0, sizeof(b->ram));
+    memset(b->read_map, 0, sizeof(b->read_map));
+    bus_connect(b, nes);
+}
+
+void bus_connect(Bus *b, NES *nes) {
     b->nes = nes;
+    // 2KB RAM mirrored through $1FFF
+    for (int page = 0x00; page < 0x20; ++page) b->read_map[page] = b->ram + ((page & 0x07) << 8);
+}
+
+// Copy page `page` into OAM from OAMADDR and charge the CPU stall
+static void bus_oam_dma(Bus *b, uint8_t page) {
+    NES *nes = b->nes;
+    uint8_t start = nes->ppu.oamaddr;
+    const uint8_t *src = b->read_map[page];
+    if (src) {
+        // RAM, PRG RAM or PRG ROM: plain memory, wrapping around OAM
+        memcpy(nes->ppu.oam + start, src, 256u - start);
+        memcpy(nes->ppu.oam, src + (256u - start), start);
+    } else {
+        // I/O or unmapped page: reads can have side effects, go one by one
+        uint16_t base = (uint16_t)(page << 8);
+        for (int i = 0; i < 256; ++i) nes->ppu.oam[(uint8_t)(start + i)] = bus_cpu_read(b, (uint16_t)(base + i));
+    }
+    uint64_t write_cycle = nes->cpu.cycles + OAM_DMA_WRITE_CYCLE;
+    int stall = OAM_DMA_CYCLES + (int)(write_cycle & 1);
+    nes->oam_dma_start = write_cycle + 1;
+    nes->oam_dma_end = nes->oam_dma_start + (uint64_t)stall;
+    nes->cpu.stall_cycles += stall;
+}
+
+void bus_map_cart(Bus *b) {
+    for (int page = 0x60; page < 0x100; ++page) b->read_map[page] = cart_cpu_page(&b->nes->cart, (uint8_t)page);
 }
 
 uint8_t bus_cpu_read(Bus *b, uint16_t addr) {
     if (!b || !b->nes) return 0;
+    const uint8_t *page = b->read_map[addr >> 8];
+    if (page) return page[addr & 0xFF];
     NES *nes = b->nes;
     if (addr <= 0x1FFF) {
         return b->ram[addr & 0x07FF];
@@ -26,7 +67,10 @@ uint8_t bus_cpu_read(Bus *b, uint16_t addr) {
         // APU/IO reads (very minimal)
         // $4015 status: return enabled flag if APU exists
         if (addr == 0x4015) {
-            return nes->apu ? apu_read(nes->apu, addr) : 0x00;
+            if (!nes->apu) return 0x00;
+            uint8_t st = apu_read(nes->apu, nes->cpu.cycles, addr);
+            nes_sync_apu(nes); // reading clears the frame IRQ
+            return st;
         }
         return 0;
     } else if (addr >= 0x6000) {
@@ -44,23 +88,19 @@ void bus_cpu_write(Bus *b, uint16_t addr, uint8_t data) {
     } else if (addr <= 0x3FFF) {
         ppu_write_reg(&nes->ppu, (uint16_t)(0x2000 + (addr & 7)), data);
     } else if (addr == 0x4014) {
-        // OAMDMA: copy 256 bytes from page data<<8 into PPU OAM starting at OAMADDR
-        uint16_t base = (uint16_t)(data << 8);
-        uint8_t start = nes->ppu.oamaddr;
-        for (int i = 0; i < 256; ++i) {
-            uint8_t v = bus_cpu_read(b, (uint16_t)(base + i));
-            nes->ppu.oam[(uint8_t)(start + i)] = v;
-        }
+        bus_oam_dma(b, data);
     } else if (addr == 0x4016) {
         controller_write(&nes->ctrl1, data);
         controller_write(&nes->ctrl2, data);
     } else if (addr >= 0x4000 && addr <= 0x4017) {
         // APU writes (very minimal)
         if (nes->apu) {
-            apu_write(nes->apu, addr, data);
+            apu_write(nes->apu, nes->cpu.cycles, addr, data);
+            nes_sync_apu(nes);
         }
     } else if (addr >= 0x6000) {
-        cart_cpu_write(&nes->cart, addr, data);
+        // Bank switches repoint the PRG pages of the page table
+        if (cart_cpu_write(&nes->cart, addr, data)) bus_map_cart(b);
     } else {
         (void)data;
     }
@@ -10,11 +10,21 @@ typedef struct {
     // 2KB internal RAM, mirrored 0x0000-0x07FF through 0x1FFF
     uint8_t ram[2 * 1024];
 
+    // Page table: CPU pages that read straight from memory (RAM, PRG RAM,
+    // PRG ROM). NULL pages go through the register decode.
+    const uint8_t *read_map[256];
+
     // Connections
     NES *nes;
 } Bus;
 
 void bus_init(Bus *b, NES *nes);
+// Re-point the RAM pages and NES link at this bus (after copying one; the
+// cartridge pages need bus_map_cart)
+void bus_connect(Bus *b, NES *nes);
+// Re-point the cartridge pages of the page table; call after loading a ROM
+// or changing its mapping
+void bus_map_cart(Bus *b);
 uint8_t bus_cpu_read(Bus *b, uint16_t addr);
 void bus_cpu_write(Bus *b, uint16_t addr, uint8_t data);
 
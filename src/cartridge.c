@@ -1,7 +1,19 @@
+#define _POSIX_C_SOURCE 200809L
 #include "cartridge.h"
-#include <stdio.h>
+#include "mapper.h"
+#include "romdb.h"
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INES_TRAINER_SIZE 512
+#define TRAINER_PRG_RAM_ADDR 0x7000
+// Granularity of the mapper bank tables (see mapper.c)
+#define PRG_BANK_SIZE (8 * 1024u)
+#define CHR_BANK_SIZE 1024u
 
 typedef struct __attribute__((packed)) {
     uint8_t magic[4]; // 'N','E','S',0x1A
@@ -9,104 +21,406 @@ typedef struct __attribute__((packed)) {
     uint8_t chr_rom_8k_units;
     uint8_t flags6;
     uint8_t flags7;
-    uint8_t prg_ram_8k_units;
-    uint8_t flags9;
-    uint8_t flags10;
-    uint8_t zero[5];
+    uint8_t flags8;   // iNES: PRG RAM in 8KB units; NES 2.0: submapper, mapper bits 8-11
+    uint8_t flags9;   // iNES: TV system; NES 2.0: PRG/CHR ROM size MSBs
+    uint8_t flags10;  // NES 2.0: PRG NVRAM/RAM shift counts
+    uint8_t flags11;  // NES 2.0: CHR NVRAM/RAM shift counts
+    uint8_t flags12;  // NES 2.0: CPU/PPU timing
+    uint8_t zero[3];
 } INesHeader;
 
+// NES 2.0 ROM size: LSB from bytes 4/5 and a 4-bit MSB from byte 9. An MSB
+// of $F switches the LSB to exponent-multiplier form, 2^E * (2M+1).
+static uint64_t nes2_rom_size(uint8_t lsb, uint8_t msb, uint32_t unit) {
+    if (msb != 0x0F) return (uint64_t)((msb << 8) | lsb) * unit;
+    int e = lsb >> 2;
+    if (e > 40) return UINT64_MAX;
+    return ((uint64_t)1 << e) * (uint64_t)((lsb & 3) * 2 + 1);
+}
+
+// NES 2.0 RAM size from a shift count: 0 means none, else 64 << shift
+static uint32_t nes2_ram_size(uint8_t shift) {
+    return shift ? 64u << shift : 0;
+}
+
 static bool header_is_nes(const INesHeader *h) {
     return h->magic[0]=='N' && h->magic[1]=='E' && h->magic[2]=='S' && h->magic[3]==0x1A;
 }
 
-int cartridge_load(const char *path, Cartridge *cart) {
-    memset(cart, 0, sizeof(*cart));
-    FILE *f = fopen(path, "rb");
-    if (!f) return -1;
+// Map the whole file read-only; PRG/CHR ROM are used in place, so instances
+// of the same ROM share its pages through the page cache. Files that cannot
+// be mapped are read into one private buffer instead.
+static int cart_open_image(const char *path, Cartridge *cart) {
+    CartImage *img = (CartImage*)calloc(1, sizeof(CartImage));
+    if (!img) return -2;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { free(img); return -1; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(INesHeader)) { close(fd); free(img); return -2; }
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+        img->data = (const uint8_t*)map;
+        img->mapped = true;
+    } else {
+        uint8_t *buf = (uint8_t*)malloc(size);
+        size_t got = 0;
+        while (buf && got < size) {
+            ssize_t n = read(fd, buf + got, size - got);
+            if (n <= 0) break;
+            got += (size_t)n;
+        }
+        if (!buf || got != size) { free(buf); close(fd); free(img); return -2; }
+        img->data = buf;
+    }
+    close(fd);
+    img->size = size;
+    atomic_init(&img->refs, 1);
+    cart->image = img;
+    return 0;
+}
+
+// Private copy of a caller's buffer
+static int cart_copy_image(const void *data, size_t size, Cartridge *cart) {
+    if (size < sizeof(INesHeader)) return -2;
+    CartImage *img = (CartImage*)calloc(1, sizeof(CartImage));
+    uint8_t *buf = (uint8_t*)malloc(size);
+    if (!img || !buf) { free(img); free(buf); return -2; }
+    memcpy(buf, data, size);
+    img->data = buf;
+    img->size = size;
+    atomic_init(&img->refs, 1);
+    cart->image = img;
+    return 0;
+}
+
+static void cart_image_release(CartImage *img) {
+    if (!img || atomic_fetch_sub_explicit(&img->refs, 1, memory_order_acq_rel) != 1) return;
+    if (img->mapped) munmap((void*)(uintptr_t)img->data, img->size);
+    else free((void*)(uintptr_t)img->data);
+    free(img);
+}
+
+// <rom>.sav next to the ROM: the extension is replaced, or added if none
+static char *cart_save_path(const char *rom_path) {
+    size_t len = strlen(rom_path);
+    const char *dot = strrchr(rom_path, '.');
+    const char *slash = strrchr(rom_path, '/');
+    if (dot && (!slash || dot > slash)) len = (size_t)(dot - rom_path);
+    char *path = (char*)malloc(len + sizeof(".sav"));
+    if (!path) return NULL;
+    memcpy(path, rom_path, len);
+    memcpy(path + len, ".sav", sizeof(".sav"));
+    return path;
+}
+
+// Map <rom>.sav as PRG RAM, growing the file to size if it is shorter (new
+// bytes read as zero). Longer files are left as they are.
+static bool cart_map_save(Cartridge *cart, const char *rom_path, uint32_t size) {
+    char *path = cart_save_path(rom_path);
+    if (!path) return false;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    free(path);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (st.st_size < (off_t)size && ftruncate(fd, (off_t)size) != 0)) { close(fd); return false; }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    // At most 64 chunks so the dirty set is one word
+    uint8_t shift = 0;
+    long page = sysconf(_SC_PAGESIZE);
+    while ((1ul << shift) < (unsigned long)(page > 0 ? page : 4096)) ++shift;
+    while (((uint64_t)size >> shift) > 64) ++shift;
+    cart->prg_ram = (uint8_t*)map;
+    cart->sav_mapped = true;
+    cart->sav_chunk_shift = shift;
+    cart->sav_dirty = 0;
+    return true;
+}
+
+bool cart_save_flush(Cartridge *c) {
+    if (!c || !c->sav_mapped || !c->sav_dirty) return true;
+    uint64_t dirty = c->sav_dirty;
+    c->sav_dirty = 0;
+    size_t chunk = (size_t)1 << c->sav_chunk_shift;
+    bool ok = true;
+    // One msync per run of adjacent dirty chunks
+    for (int i = 0; i < 64 && (dirty >> i);) {
+        if (!((dirty >> i) & 1)) { ++i; continue; }
+        int run = i;
+        while (run < 64 && ((dirty >> run) & 1)) ++run;
+        size_t off = (size_t)i << c->sav_chunk_shift;
+        if (off >= c->prg_ram_size) break;
+        size_t len = (size_t)(run - i) * chunk;
+        if (off + len > c->prg_ram_size) len = c->prg_ram_size - off;
+        if (msync(c->prg_ram + off, len, MS_SYNC) != 0) {
+            ok = false;
+            for (int k = i; k < run; ++k) c->sav_dirty |= 1ull << k;
+        }
+        i = run;
+    }
+    return ok;
+}
+
+bool cart_detach_save(Cartridge *c) {
+    if (!c || !c->sav_mapped) return true;
+    uint8_t *ram = (uint8_t*)malloc(c->prg_ram_size);
+    if (!ram) return false;
+    memcpy(ram, c->prg_ram, c->prg_ram_size);
+    cart_save_flush(c);
+    munmap(c->prg_ram, c->prg_ram_size);
+    c->prg_ram = ram;
+    c->sav_mapped = false;
+    c->sav_chunk_shift = 13;
+    c->sav_dirty = 0;
+    return true;
+}
+
+// Set the cartridge up from its image; sav_path names the ROM whose .sav
+// backs battery RAM, or is NULL for plain memory
+static int cart_parse_image(Cartridge *cart, const char *sav_path) {
+    const uint8_t *image = cart->image->data;
+    size_t image_size = cart->image->size;
     INesHeader h;
-    if (fread(&h, 1, sizeof(h), f) != sizeof(h)) { fclose(f); return -2; }
-    if (!header_is_nes(&h)) { fclose(f); return -3; }
+    memcpy(&h, image, sizeof(h));
+    if (!header_is_nes(&h)) { cartridge_free(cart); return -3; }
 
-    uint8_t mapper_lower = (h.flags6 >> 4) & 0x0F;
-    uint8_t mapper_upper = (h.flags7 & 0xF0); // already high nibble in correct position
-    cart->mapper = (uint8_t)(mapper_lower | mapper_upper);
+    cart->nes2 = (h.flags7 & 0x0C) == 0x08;
+    cart->mapper = (uint16_t)((h.flags6 >> 4) | (h.flags7 & 0xF0));
     cart->trainer_present = (h.flags6 & 0x04) != 0;
     cart->battery = (h.flags6 & 0x02) != 0;
     cart->mirror = (h.flags6 & 0x08) ? MIRROR_FOUR : ((h.flags6 & 0x01) ? MIRROR_VERTICAL : MIRROR_HORIZONTAL);
 
-    if (cart->mapper != 0) { fclose(f); return -4; }
+    uint64_t prg_rom_size, chr_rom_size;
+    uint32_t prg_ram_size, chr_ram_size;
+    if (cart->nes2) {
+        cart->mapper |= (uint16_t)((h.flags8 & 0x0F) << 8);
+        cart->submapper = (uint8_t)(h.flags8 >> 4);
+        prg_rom_size = nes2_rom_size(h.prg_rom_16k_units, h.flags9 & 0x0F, 16 * 1024u);
+        chr_rom_size = nes2_rom_size(h.chr_rom_8k_units, h.flags9 >> 4, 8 * 1024u);
+        prg_ram_size = nes2_ram_size(h.flags10 & 0x0F) + nes2_ram_size(h.flags10 >> 4);
+        chr_ram_size = nes2_ram_size(h.flags11 & 0x0F) + nes2_ram_size(h.flags11 >> 4);
+        cart->timing = (CartTiming)(h.flags12 & 3);
+    } else {
+        // Old dumping tools wrote signatures into bytes 7-15; if the unused
+        // tail is dirty the mapper high nibble is garbage too
+        if (h.flags12 || h.zero[0] || h.zero[1] || h.zero[2]) cart->mapper &= 0x0F;
+        prg_rom_size = (uint64_t)h.prg_rom_16k_units * 16 * 1024u;
+        chr_rom_size = (uint64_t)h.chr_rom_8k_units * 8 * 1024u;
+        prg_ram_size = (h.flags8 ? h.flags8 : 1) * 8 * 1024u; // 0 means 8KB
+        chr_ram_size = 0;
+        cart->timing = (h.flags9 & 1) ? CART_TIMING_PAL : CART_TIMING_NTSC;
+    }
 
+    size_t pos = sizeof(INesHeader);
+    const uint8_t *trainer = NULL;
     if (cart->trainer_present) {
-        // Skip trainer 512 bytes
-        if (fseek(f, 512, SEEK_CUR) != 0) { fclose(f); return -5; }
+        if (image_size < pos + INES_TRAINER_SIZE) { cartridge_free(cart); return -5; }
+        trainer = image + pos;
+        pos += INES_TRAINER_SIZE;
     }
+    // The bank tables always expose whole 8KB PRG and 1KB CHR windows, so
+    // NES 2.0 sizes that are not whole banks would map past the buffers
+    if (prg_rom_size == 0 || prg_rom_size > UINT32_MAX || prg_rom_size % PRG_BANK_SIZE) { cartridge_free(cart); return -6; }
+    if (chr_rom_size % CHR_BANK_SIZE) { cartridge_free(cart); return -12; }
+    if (image_size - pos < prg_rom_size) { cartridge_free(cart); return -7; }
+    if (chr_rom_size > image_size - pos - prg_rom_size) { cartridge_free(cart); return -10; }
+    cart->prg_rom_size = (uint32_t)prg_rom_size;
+    cart->prg_rom = image + pos;
 
-    cart->prg_rom_size = (uint32_t)h.prg_rom_16k_units * 16 * 1024u;
-    cart->chr_size = (uint32_t)h.chr_rom_8k_units * 8 * 1024u;
+    // Headers are often wrong; the database keys on the ROM contents
+    cart->crc32 = crc32_update(0, image + pos, (size_t)(prg_rom_size + chr_rom_size));
+    RomDbEntry db;
+    if (romdb_lookup(cart->crc32, &db)) {
+        cart->db_match = true;
+        if (db.mapper != ROMDB_KEEP) { cart->mapper = (uint16_t)db.mapper; cart->submapper = 0; }
+        if (db.submapper != ROMDB_KEEP) cart->submapper = (uint8_t)db.submapper;
+        if (db.mirror != ROMDB_KEEP) cart->mirror = (MirrorMode)db.mirror;
+        if (db.prg_ram != ROMDB_KEEP) prg_ram_size = (uint32_t)db.prg_ram;
+        if (db.chr_ram != ROMDB_KEEP) chr_ram_size = (uint32_t)db.chr_ram;
+        if (db.battery != ROMDB_KEEP) cart->battery = db.battery != 0;
+        if (db.timing != ROMDB_KEEP) cart->timing = (CartTiming)db.timing;
+    }
 
-    if (cart->prg_rom_size == 0) { fclose(f); return -6; }
-    cart->prg_rom = (uint8_t*)malloc(cart->prg_rom_size);
-    if (!cart->prg_rom) { fclose(f); return -6; }
-    if (fread(cart->prg_rom, 1, cart->prg_rom_size, f) != cart->prg_rom_size) { fclose(f); return -7; }
+    cart->ops = mapper_find(cart->mapper);
+    if (!cart->ops) { cartridge_free(cart); return -4; }
+    pos += cart->prg_rom_size;
 
-    if (cart->chr_size == 0) {
-        // Allocate 8KB CHR RAM if no CHR ROM present
-        cart->chr_size = 8 * 1024u;
+    if (chr_rom_size == 0) {
+        // CHR RAM: as declared (whole 1KB banks), or 8KB if the header does not say
+        if (chr_ram_size % CHR_BANK_SIZE) { cartridge_free(cart); return -12; }
+        cart->chr_size = chr_ram_size ? chr_ram_size : 8 * 1024u;
         cart->chr = (uint8_t*)calloc(1, cart->chr_size);
         cart->chr_is_ram = true;
-        if (!cart->chr) { fclose(f); return -8; }
+        if (!cart->chr) { cartridge_free(cart); return -8; }
     } else {
-        cart->chr = (uint8_t*)malloc(cart->chr_size);
+        // Read-only image; PPU writes are gated on chr_is_ram
+        cart->chr = (uint8_t*)(uintptr_t)(image + pos);
+        cart->chr_size = (uint32_t)chr_rom_size;
         cart->chr_is_ram = false;
-        if (!cart->chr) { fclose(f); return -9; }
-        if (fread(cart->chr, 1, cart->chr_size, f) != cart->chr_size) { fclose(f); return -10; }
     }
 
-    // Allocate 8KB PRG RAM for NROM (some ROMs may not use it; safe default)
-    cart->prg_ram_size = 8 * 1024u;
-    cart->prg_ram = (uint8_t*)calloc(1, cart->prg_ram_size);
-    if (!cart->prg_ram) { fclose(f); return -11; }
+    // PRG RAM as declared (a trainer needs some to load into). The CPU sees
+    // an 8KB window; smaller RAM mirrors through it.
+    if (trainer && prg_ram_size < 8 * 1024u) prg_ram_size = 8 * 1024u;
+    if (prg_ram_size) {
+        uint32_t window = 64;
+        while (window < prg_ram_size && window < 8 * 1024u) window <<= 1;
+        cart->prg_ram_size = prg_ram_size > window ? prg_ram_size : window;
+        cart->prg_ram_mask = window - 1;
+        if (!cart->battery || !sav_path || !cart_map_save(cart, sav_path, cart->prg_ram_size)) {
+            cart->prg_ram = (uint8_t*)calloc(1, cart->prg_ram_size);
+            cart->sav_chunk_shift = 13; // whole window in one (unused) dirty bit
+        }
+        if (!cart->prg_ram) { cartridge_free(cart); return -11; }
+    }
+    // The trainer is loaded into PRG RAM at $7000
+    if (trainer) {
+        memcpy(cart->prg_ram + TRAINER_PRG_RAM_ADDR - 0x6000, trainer, INES_TRAINER_SIZE);
+        cart->sav_dirty |= 1ull << ((TRAINER_PRG_RAM_ADDR - 0x6000) >> cart->sav_chunk_shift);
+    }
 
-    fclose(f);
+    cart->ops->reset(cart);
+    cart->ops->sync(cart);
     return 0;
 }
 
+int cartridge_load(const char *path, Cartridge *cart) {
+    memset(cart, 0, sizeof(*cart));
+    int rc = cart_open_image(path, cart);
+    return rc != 0 ? rc : cart_parse_image(cart, path);
+}
+
+int cartridge_load_mem(const void *data, size_t size, Cartridge *cart) {
+    memset(cart, 0, sizeof(*cart));
+    int rc = cart_copy_image(data, size, cart);
+    return rc != 0 ? rc : cart_parse_image(cart, NULL);
+}
+
 void cartridge_free(Cartridge *cart) {
     if (!cart) return;
-    free(cart->prg_rom); cart->prg_rom = NULL; cart->prg_rom_size = 0;
-    free(cart->chr); cart->chr = NULL; cart->chr_size = 0; cart->chr_is_ram = false;
-    free(cart->prg_ram); cart->prg_ram = NULL; cart->prg_ram_size = 0;
+    if (cart->chr_is_ram) free(cart->chr);
+    cart->chr = NULL; cart->chr_size = 0; cart->chr_is_ram = false;
+    cart_image_release(cart->image);
+    cart->image = NULL;
+    cart->prg_rom = NULL; cart->prg_rom_size = 0;
+    if (cart->sav_mapped) {
+        cart_save_flush(cart);
+        munmap(cart->prg_ram, cart->prg_ram_size);
+    } else {
+        free(cart->prg_ram);
+    }
+    cart->prg_ram = NULL; cart->prg_ram_size = 0; cart->prg_ram_mask = 0;
+    cart->sav_mapped = false; cart->sav_dirty = 0;
+    memset(cart->prg_map, 0, sizeof(cart->prg_map));
+    memset(cart->chr_map, 0, sizeof(cart->chr_map));
+    cart->ops = NULL;
+    cart->irq = false;
+}
+
+bool cart_clone(const Cartridge *src, Cartridge *dst) {
+    *dst = *src;
+    dst->prg_ram = NULL;
+    dst->sav_mapped = false;
+    dst->sav_dirty = 0;
+    dst->sav_chunk_shift = 13;
+    if (src->chr_is_ram) dst->chr = NULL;
+    if (src->prg_ram) {
+        dst->prg_ram = (uint8_t*)malloc(src->prg_ram_size);
+        if (!dst->prg_ram) { dst->image = NULL; dst->chr_is_ram = false; return false; }
+        memcpy(dst->prg_ram, src->prg_ram, src->prg_ram_size);
+    }
+    if (src->chr_is_ram) {
+        dst->chr = (uint8_t*)malloc(src->chr_size);
+        if (!dst->chr) { free(dst->prg_ram); dst->prg_ram = NULL; dst->image = NULL; dst->chr_is_ram = false; return false; }
+        memcpy(dst->chr, src->chr, src->chr_size);
+        // Same banks, this copy's RAM
+        for (int i = 0; i < 8; ++i) dst->chr_map[i] = dst->chr + (src->chr_map[i] - src->chr);
+    }
+    if (dst->image) atomic_fetch_add_explicit(&dst->image->refs, 1, memory_order_relaxed);
+    return true;
 }
 
 uint8_t cart_cpu_read(Cartridge *c, uint16_t addr) {
     if (!c) return 0;
     // $6000-$7FFF PRG RAM
     if (addr >= 0x6000 && addr <= 0x7FFF) {
-        if (c->prg_ram && c->prg_ram_size) return c->prg_ram[addr - 0x6000];
-        return 0;
+        return c->prg_ram ? c->prg_ram[addr & c->prg_ram_mask] : 0;
     }
-    // $8000-$FFFF PRG ROM
+    // $8000-$FFFF PRG ROM through the bank table
     if (addr >= 0x8000) {
-        if (!c->prg_rom || c->prg_rom_size == 0) return 0;
-        uint32_t offset = (uint32_t)addr - 0x8000u;
-        if (c->prg_rom_size == 16 * 1024u) {
-            // Mirror 16KB into both banks
-            offset %= 16 * 1024u;
-        } else {
-            offset %= c->prg_rom_size;
-        }
-        return c->prg_rom[offset];
+        if (c->ops && c->ops->cpu_read) return c->ops->cpu_read(c, addr);
+        const uint8_t *bank = c->prg_map[(addr >> 13) & 3];
+        return bank ? bank[addr & 0x1FFF] : 0;
     }
     return 0;
 }
 
-void cart_cpu_write(Cartridge *c, uint16_t addr, uint8_t data) {
-    if (!c) return;
+bool cart_cpu_write(Cartridge *c, uint16_t addr, uint8_t data) {
+    if (!c) return false;
     // PRG RAM
     if (addr >= 0x6000 && addr <= 0x7FFF) {
-        if (c->prg_ram && c->prg_ram_size) c->prg_ram[addr - 0x6000] = data;
-        return;
+        if (c->prg_ram) {
+            uint32_t off = addr & c->prg_ram_mask;
+            c->prg_ram[off] = data;
+            c->sav_dirty |= 1ull << (off >> c->sav_chunk_shift);
+        }
+        return false;
+    }
+    // Mapper registers
+    if (addr >= 0x8000 && c->ops && c->ops->cpu_write) {
+        const uint8_t *before[4];
+        memcpy(before, c->prg_map, sizeof(before));
+        c->ops->cpu_write(c, addr, data);
+        return memcmp(before, c->prg_map, sizeof(before)) != 0;
+    }
+    return false;
+}
+
+const uint8_t *cart_cpu_page(Cartridge *c, uint8_t page) {
+    if (!c) return NULL;
+    if (page >= 0x60 && page <= 0x7F) {
+        if (!c->prg_ram || c->prg_ram_mask < 0xFF) return NULL;
+        return c->prg_ram + (((uint32_t)page << 8) & c->prg_ram_mask);
+    }
+    if (page >= 0x80) {
+        if (c->ops && c->ops->cpu_read) return NULL;
+        const uint8_t *bank = c->prg_map[(page >> 5) & 3];
+        return bank ? bank + ((uint32_t)(page & 0x1F) << 8) : NULL;
     }
-    // Writes to PRG ROM ignored for NROM
-    (void)c; (void)addr; (void)data;
+    return NULL;
+}
+
+uint8_t cart_ppu_read(Cartridge *c, uint16_t addr) {
+    if (c->ops && c->ops->ppu_read) return c->ops->ppu_read(c, addr);
+    const uint8_t *bank = c->chr_map[(addr >> 10) & 7];
+    return bank ? bank[addr & 0x03FF] : 0;
+}
+
+void cart_ppu_write(Cartridge *c, uint16_t addr, uint8_t data) {
+    if (c->ops && c->ops->ppu_write) { c->ops->ppu_write(c, addr, data); return; }
+    // Only CHR RAM is writable
+    uint8_t *bank = c->chr_map[(addr >> 10) & 7];
+    if (bank && c->chr_is_ram) bank[addr & 0x03FF] = data;
+}
+
+// State blob: the mapper IRQ line, then the mapper's own registers
+size_t cart_state_size(const Cartridge *c) {
+    return c->ops ? 1 + c->ops->state_size : 0;
+}
+
+size_t cart_save_state(const Cartridge *c, void *buf) {
+    if (!c->ops) return 0;
+    uint8_t *out = (uint8_t*)buf;
+    out[0] = c->irq ? 1 : 0;
+    return 1 + c->ops->save_state(c, out + 1);
+}
+
+bool cart_load_state(Cartridge *c, const void *buf, size_t len) {
+    if (!c->ops || len != cart_state_size(c)) return false;
+    const uint8_t *in = (const uint8_t*)buf;
+    if (!c->ops->load_state(c, in + 1, len - 1)) return false;
+    c->irq = in[0] != 0;
+    return true;
 }
@@ -1,35 +1,134 @@
 #pragma once
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
 
 typedef enum {
     MIRROR_HORIZONTAL = 0,
     MIRROR_VERTICAL = 1,
-    MIRROR_FOUR = 2
+    MIRROR_FOUR = 2,
+    MIRROR_SINGLE_LOW = 3,  // every nametable reads the first 1KB
+    MIRROR_SINGLE_HIGH = 4  // every nametable reads the second 1KB
 } MirrorMode;
 
+// CPU/PPU timing from the header (emulation is NTSC regardless)
+typedef enum {
+    CART_TIMING_NTSC = 0,
+    CART_TIMING_PAL = 1,
+    CART_TIMING_MULTI = 2,  // works on either
+    CART_TIMING_DENDY = 3
+} CartTiming;
+
+// The .nes file, mmap'd read-only (or read into memory if it cannot be
+// mapped). Immutable, so cartridges cloned from one another share it; the
+// last cartridge_free releases it.
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    bool mapped;
+    _Atomic uint32_t refs;
+} CartImage;
+
+typedef struct Mapper Mapper; // see mapper.h
+
+// Bank registers of the supported mappers; only the cartridge's own member
+// is live. Plain data, so saving a mapper is a copy.
+typedef union {
+    struct { uint8_t bank; } latch; // UxROM, CNROM, AxROM
+    struct {
+        uint8_t shift, count;       // serial port
+        uint8_t control, chr0, chr1, prg;
+    } mmc1;
+    struct {
+        uint8_t select;             // $8000: target register and bank modes
+        uint8_t r[8];               // $8001: bank registers R0-R7
+        uint8_t mirror;             // $A000
+        uint8_t irq_latch, irq_counter;
+        bool irq_enabled, irq_reload;
+    } mmc3;
+} MapperRegs;
+
 typedef struct {
+    // The .nes file; PRG ROM and CHR ROM point into it, and clones share it
+    CartImage *image;
+
     // Raw ROM/RAM
-    uint8_t *prg_rom;       // PRG ROM data
+    const uint8_t *prg_rom; // PRG ROM data (inside image)
     uint32_t prg_rom_size;  // size in bytes (16KB or 32KB multiples)
 
-    uint8_t *chr;           // CHR ROM or CHR RAM
+    uint8_t *chr;           // CHR ROM (inside image, read-only) or CHR RAM
     uint32_t chr_size;      // size in bytes (0 => allocate 8KB CHR RAM)
     bool chr_is_ram;        // true if CHR is RAM (no CHR ROM in file)
 
-    uint8_t *prg_ram;       // 8KB PRG RAM typical for NROM
+    uint8_t *prg_ram;       // PRG RAM (volatile and battery-backed), NULL if none
     uint32_t prg_ram_size;
+    uint32_t prg_ram_mask;  // visible window at $6000-$7FFF, mirrored
+    // Battery-backed PRG RAM is a shared mapping of <rom>.sav, so the OS
+    // keeps it across crashes; writes mark chunks (host pages, or multiples
+    // for large RAM) in sav_dirty and cart_save_flush msyncs only those.
+    bool sav_mapped;
+    uint8_t sav_chunk_shift;
+    uint64_t sav_dirty;
 
-    // iNES header params
-    uint8_t mapper;         // Only 0 supported (NROM)
-    MirrorMode mirror;
+    // Header params (iNES or NES 2.0, corrected by the ROM database)
+    bool nes2;              // header is NES 2.0
+    uint16_t mapper;        // mapper number (12 bits with NES 2.0)
+    uint8_t submapper;
+    MirrorMode mirror;      // current mirroring (mappers may switch it)
     bool battery;
     bool trainer_present;
+    CartTiming timing;
+    uint32_t crc32;         // CRC32 of PRG ROM + CHR ROM (database key)
+    bool db_match;          // header fields were overridden from the database
+
+    // Bank pointer tables: what the CPU sees at $8000-$FFFF in 8KB slots and
+    // the PPU at $0000-$1FFF in 1KB slots. Bank switching only repoints
+    // these, so banked access costs the same as NROM.
+    const uint8_t *prg_map[4];
+    uint8_t *chr_map[8];
+    const Mapper *ops;
+    MapperRegs regs;
+    bool irq;               // mapper IRQ line (MMC3 scanline counter)
 } Cartridge;
 
+// Battery-backed carts get their PRG RAM from <rom>.sav (the .nes extension
+// replaced), created if missing; if it cannot be opened the RAM is plain
+// memory and sav_mapped stays false.
 int cartridge_load(const char *path, Cartridge *cart);
+// Same from a .nes image in memory; the data is copied. Battery RAM is
+// plain memory (there is no file to keep it in).
+int cartridge_load_mem(const void *data, size_t size, Cartridge *cart);
 void cartridge_free(Cartridge *cart);
+// Copy a loaded cartridge: the ROM image is shared, PRG RAM and CHR RAM are
+// copied. The copy's PRG RAM is plain memory (never the .sav file). Free it
+// with cartridge_free as usual.
+bool cart_clone(const Cartridge *src, Cartridge *dst);
+
+// Write dirty chunks of a mapped .sav back to disk and wait for it. Cheap
+// when nothing changed; call at frame boundaries or from a timer. False on
+// an I/O error (the data stays in memory and is retried next time).
+bool cart_save_flush(Cartridge *c);
+// Move mapped PRG RAM into plain memory: the .sav is flushed and closed, and
+// later writes no longer reach it (movie playback must not touch the save).
+// Rebuild the bus page table afterwards. True if nothing was mapped.
+bool cart_detach_save(Cartridge *c);
 
-// PRG mapping helpers (NROM)
+// CPU side: PRG RAM at $6000-$7FFF, banked PRG ROM at $8000-$FFFF. Writes
+// to $8000+ go to the mapper; returns true if the PRG banks moved (the bus
+// page table must be rebuilt).
 uint8_t cart_cpu_read(Cartridge *c, uint16_t addr);
-void cart_cpu_write(Cartridge *c, uint16_t addr, uint8_t data);
+bool cart_cpu_write(Cartridge *c, uint16_t addr, uint8_t data);
+// Start of the 256-byte block mapped at CPU page $xx00, or NULL if that page
+// is not plain memory
+const uint8_t *cart_cpu_page(Cartridge *c, uint8_t page);
+
+// PPU side: pattern tables at $0000-$1FFF through the CHR bank table
+uint8_t cart_ppu_read(Cartridge *c, uint16_t addr);
+void cart_ppu_write(Cartridge *c, uint16_t addr, uint8_t data);
+
+// Mapper bank state for save states: a plain copy of the live registers.
+// Loading re-applies the banks (rebuild the bus page table afterwards).
+size_t cart_state_size(const Cartridge *c);
+size_t cart_save_state(const Cartridge *c, void *buf);
+bool cart_load_state(Cartridge *c, const void *buf, size_t len);
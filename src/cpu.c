@@ -138,6 +138,12 @@ static inline uint8_t sbc(CPU *c, uint8_t a, uint8_t b) {
 
 // Execute instruction
 int cpu_step(CPU *c) {
+    if (c->stall_cycles > 0) {
+        int n = c->stall_cycles;
+        c->stall_cycles = 0;
+        c->cycles += (uint64_t)n;
+        return n;
+    }
     // Service pending interrupts (simplified; caller can trigger via cpu_irq/cpu_nmi)
     if (c->nmi_line) { c->nmi_line = false; cpu_nmi(c); return 7; }
     if (c->irq_line && !(c->P & FLAG_I)) { c->irq_line = false; cpu_irq(c); return 7; }
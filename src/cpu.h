@@ -20,6 +20,9 @@ typedef struct {
 
     // Cycle count (since power on)
     uint64_t cycles;
+
+    // Cycles stolen by DMA, burned before the next instruction
+    int stall_cycles;
 } CPU;
 
 void cpu_connect_bus(CPU *c, Bus *b);
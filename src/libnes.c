@@ -0,0 +1,161 @@
+#include "libnes.h"
+#include <stdlib.h>
+#include "audio.h"
+#include "nes.h"
+
+struct LibNES {
+    NES nes;
+    bool loaded;
+    AudioSink *sink;
+};
+
+// Audio for the embedder: the APU's render thread fills a ring, the caller
+// drains it with libnes_read_audio
+typedef struct {
+    AudioSink base;
+    AudioRing ring;
+} BufferSink;
+
+static void buffer_sink_write(AudioSink *s, const float *samples, int count) {
+    audio_ring_write(&((BufferSink*)s)->ring, samples, (uint32_t)count);
+}
+
+static void buffer_sink_close(AudioSink *s) {
+    audio_ring_free(&((BufferSink*)s)->ring);
+    free(s);
+}
+
+static AudioSink *buffer_sink_open(int sample_rate) {
+    BufferSink *b = (BufferSink*)calloc(1, sizeof(BufferSink));
+    if (!b) return NULL;
+    if (!audio_ring_init(&b->ring, (uint32_t)sample_rate)) { free(b); return NULL; }
+    b->base.write = buffer_sink_write;
+    b->base.close = buffer_sink_close;
+    b->base.sample_rate = sample_rate;
+    b->base.realtime = false;
+    return &b->base;
+}
+
+// Cartridge loader codes to the stable ones
+static int libnes_rom_error(int rc) {
+    switch (rc) {
+        case 0: return 0;
+        case -1: return LIBNES_ERR_IO;
+        case -4: return LIBNES_ERR_MAPPER;
+        case -8: case -11: return LIBNES_ERR_NOMEM;
+        default: return LIBNES_ERR_FORMAT;
+    }
+}
+
+int libnes_abi_version(void) {
+    return LIBNES_ABI_VERSION;
+}
+
+LibNES *libnes_create(void) {
+    LibNES *h = (LibNES*)calloc(1, sizeof(LibNES));
+    if (!h) return NULL;
+    nes_init(&h->nes);
+    if (!h->nes.apu || !nes_framebuffer(&h->nes)) {
+        nes_free(&h->nes);
+        free(h);
+        return NULL;
+    }
+    return h;
+}
+
+void libnes_destroy(LibNES *h) {
+    if (!h) return;
+    apu_set_sink(h->nes.apu, NULL);
+    audio_sink_close(&h->sink);
+    nes_free(&h->nes);
+    free(h);
+}
+
+// A new ROM starts from a powered-off machine; the audio sink carries over
+static bool libnes_power_cycle(LibNES *h) {
+    if (!h->loaded) return true;
+    h->loaded = false;
+    apu_set_sink(h->nes.apu, NULL);
+    nes_free(&h->nes);
+    nes_init(&h->nes);
+    if (!h->nes.apu || !nes_framebuffer(&h->nes)) return false;
+    if (h->sink && !apu_set_sink(h->nes.apu, h->sink)) audio_sink_close(&h->sink);
+    return true;
+}
+
+static int libnes_attach(LibNES *h, int rc) {
+    h->loaded = rc == 0;
+    if (rc != 0) return libnes_rom_error(rc);
+    nes_reset(&h->nes);
+    return 0;
+}
+
+int libnes_load_rom(LibNES *h, const void *data, size_t size) {
+    if (!h || !data) return LIBNES_ERR_ARG;
+    if (!libnes_power_cycle(h)) return LIBNES_ERR_NOMEM;
+    return libnes_attach(h, nes_load_rom_mem(&h->nes, data, size));
+}
+
+int libnes_load_rom_file(LibNES *h, const char *path) {
+    if (!h || !path) return LIBNES_ERR_ARG;
+    if (!libnes_power_cycle(h)) return LIBNES_ERR_NOMEM;
+    return libnes_attach(h, nes_load_rom(&h->nes, path));
+}
+
+int libnes_reset(LibNES *h) {
+    if (!h || !h->loaded) return LIBNES_ERR_ARG;
+    nes_reset(&h->nes);
+    return 0;
+}
+
+int libnes_set_input(LibNES *h, int port, uint8_t buttons) {
+    if (!h || port < 0 || port > 1) return LIBNES_ERR_ARG;
+    controller_set_state(port ? &h->nes.ctrl2 : &h->nes.ctrl1, buttons);
+    return 0;
+}
+
+int libnes_step_frame(LibNES *h) {
+    if (!h || !h->loaded) return LIBNES_ERR_ARG;
+    nes_run_frame(&h->nes);
+    apu_end_frame(h->nes.apu);
+    return 0;
+}
+
+const uint32_t *libnes_framebuffer(const LibNES *h) {
+    return h ? h->nes.ppu.framebuffer : NULL;
+}
+
+int libnes_set_audio(LibNES *h, int sample_rate) {
+    if (!h || sample_rate < 0) return LIBNES_ERR_ARG;
+    apu_set_sink(h->nes.apu, NULL);
+    audio_sink_close(&h->sink);
+    if (sample_rate == 0) return 0;
+    h->sink = buffer_sink_open(sample_rate);
+    if (!h->sink || !apu_set_sink(h->nes.apu, h->sink)) {
+        audio_sink_close(&h->sink);
+        return LIBNES_ERR_NOMEM;
+    }
+    return 0;
+}
+
+size_t libnes_read_audio(LibNES *h, float *out, size_t max) {
+    if (!h || !h->sink || !out) return 0;
+    AudioRing *ring = &((BufferSink*)h->sink)->ring;
+    uint32_t n = audio_ring_fill(ring);
+    if (n > max) n = (uint32_t)max;
+    return n ? audio_ring_read(ring, out, n) : 0;
+}
+
+size_t libnes_state_size(const LibNES *h) {
+    return h && h->loaded ? nes_state_size(&h->nes) : 0;
+}
+
+size_t libnes_save_state(const LibNES *h, void *buf, size_t cap) {
+    if (!h || !h->loaded || !buf) return 0;
+    return nes_save_state(&h->nes, buf, cap);
+}
+
+int libnes_load_state(LibNES *h, const void *buf, size_t len) {
+    if (!h || !h->loaded || !buf) return LIBNES_ERR_ARG;
+    return nes_load_state(&h->nes, buf, len) ? 0 : LIBNES_ERR_FORMAT;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// libnes: the emulator core as a library with a stable C ABI. Everything an
+// emulator needs lives in its LibNES handle, so any number of instances can
+// run in one process, each on its own thread (a single instance is not safe
+// to call from two threads at once). The only process-wide data are
+// read-only tables built on first use and the ROM header database
+// (romdb.h), which is shared configuration.
+//
+// Only this header is part of the ABI: the handle is opaque, and functions
+// are only ever added, with LIBNES_ABI_VERSION bumped on incompatible change.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define LIBNES_API __attribute__((visibility("default")))
+#else
+#define LIBNES_API
+#endif
+
+#define LIBNES_ABI_VERSION 1
+
+#define LIBNES_WIDTH 256
+#define LIBNES_HEIGHT 240
+
+// Controller buttons, one bit each
+#define LIBNES_BUTTON_A      0x01
+#define LIBNES_BUTTON_B      0x02
+#define LIBNES_BUTTON_SELECT 0x04
+#define LIBNES_BUTTON_START  0x08
+#define LIBNES_BUTTON_UP     0x10
+#define LIBNES_BUTTON_DOWN   0x20
+#define LIBNES_BUTTON_LEFT   0x40
+#define LIBNES_BUTTON_RIGHT  0x80
+
+// Errors (functions returning int give 0 on success)
+#define LIBNES_ERR_ARG    (-1) // bad argument, or no ROM loaded yet
+#define LIBNES_ERR_IO     (-2) // ROM file cannot be read
+#define LIBNES_ERR_FORMAT (-3) // not an iNES/NES 2.0 image, or truncated
+#define LIBNES_ERR_MAPPER (-4) // mapper not supported
+#define LIBNES_ERR_NOMEM  (-5)
+
+typedef struct LibNES LibNES;
+
+// ABI version the library was built with; compare with LIBNES_ABI_VERSION
+LIBNES_API int libnes_abi_version(void);
+
+// NULL if out of memory
+LIBNES_API LibNES *libnes_create(void);
+LIBNES_API void libnes_destroy(LibNES *nes);
+
+// Load a .nes image (copied) and power on. Replaces any loaded ROM. Battery
+// RAM is plain memory; persist it through save states.
+LIBNES_API int libnes_load_rom(LibNES *nes, const void *data, size_t size);
+// Same from a file; battery RAM is kept in <rom>.sav as by nes_emu
+LIBNES_API int libnes_load_rom_file(LibNES *nes, const char *path);
+LIBNES_API int libnes_reset(LibNES *nes);
+
+// port 0 or 1; buttons is a LIBNES_BUTTON_* mask, held until changed
+LIBNES_API int libnes_set_input(LibNES *nes, int port, uint8_t buttons);
+// Run one video frame
+LIBNES_API int libnes_step_frame(LibNES *nes);
+// LIBNES_WIDTH x LIBNES_HEIGHT pixels, 0xAARRGGBB, row-major; valid until
+// libnes_destroy and updated by each frame
+LIBNES_API const uint32_t *libnes_framebuffer(const LibNES *nes);
+
+// Audio is off by default. With a sample rate, mono float samples are
+// rendered on a helper thread into a buffer of about one second; a frame's
+// samples become readable shortly after libnes_step_frame returns. Read
+// regularly: while the buffer is full, newly rendered samples are dropped
+// (the buffered ones are kept). Rate 0 turns audio off.
+LIBNES_API int libnes_set_audio(LibNES *nes, int sample_rate);
+// Copy up to max buffered samples into out; returns how many
+LIBNES_API size_t libnes_read_audio(LibNES *nes, float *out, size_t max);
+
+// Save states: fixed size for a loaded ROM, and valid only for the same ROM
+// and library build
+LIBNES_API size_t libnes_state_size(const LibNES *nes);
+// Returns bytes written, or 0 if cap is too small or no ROM is loaded
+LIBNES_API size_t libnes_save_state(const LibNES *nes, void *buf, size_t cap);
+LIBNES_API int libnes_load_state(LibNES *nes, const void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,8 +1,15 @@
+#define _POSIX_C_SOURCE 200809L
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
+#include "mapper.h"
+#include "movie.h"
 #include "nes.h"
+#include "rewind.h"
+#include "romdb.h"
 #include "video.h"
 #ifdef HAVE_SDL2
 #include <SDL.h>
@@ -40,9 +47,149 @@ static int parse_fps(int argc, char **argv) {
     for (int i = 1; i < argc - 1; ++i) {
         if (strcmp(argv[i], "--fps") == 0) return atoi(argv[i+1]);
     }
-    return 30;
+    return 0; // native NTSC rate
 }
 
+typedef enum { SYNC_NONE = 0, SYNC_TIMER, SYNC_AUDIO } SyncMode;
+
+// NTSC: 1789772.7 Hz CPU / 29780.5 cycles per frame
+#define NTSC_FRAME_HZ 60.0988
+// Dynamic rate control: max resampling ratio deviation
+#define DRC_MAX_ADJUST 0.005
+// Give up waiting for the audio device to drain after this long
+#define AUDIO_WAIT_MAX_MS 100
+// Samples buffered between the emulation thread and the SDL callback
+#define AUDIO_RING_SAMPLES 8192
+#define AUDIO_DEFAULT_RATE 44100
+// Battery saves: frames between msyncs of dirty .sav pages (~1 s)
+#define SAVE_FLUSH_FRAMES 60
+// Movies: frames between state hashes (one second)
+#define MOVIE_DEFAULT_HASH_INTERVAL 60
+// Movie keyframes: frames between save states (ten seconds)
+#define MOVIE_DEFAULT_KEYFRAME_INTERVAL 600
+// Rewind: frames between snapshots; 64MB holds roughly 10 minutes
+#define REWIND_DEFAULT_INTERVAL 2
+
+static SyncMode parse_sync(int argc, char **argv, SyncMode dflt) {
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "--sync") == 0) {
+            if (strcmp(argv[i+1], "audio") == 0) return SYNC_AUDIO;
+            if (strcmp(argv[i+1], "timer") == 0) return SYNC_TIMER;
+            if (strcmp(argv[i+1], "none") == 0) return SYNC_NONE;
+            fprintf(stderr, "Warning: unknown --sync mode '%s'.\n", argv[i+1]);
+        }
+    }
+    return dflt;
+}
+
+static int parse_audio_rate(int argc, char **argv) {
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "--audio-rate") == 0) {
+            int hz = atoi(argv[i+1]);
+            if (hz >= 8000 && hz <= 192000) return hz;
+            fprintf(stderr, "Warning: --audio-rate %s out of range; using %d.\n", argv[i+1], AUDIO_DEFAULT_RATE);
+        }
+    }
+    return AUDIO_DEFAULT_RATE;
+}
+
+static BlipQuality parse_audio_quality(int argc, char **argv) {
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "--audio-quality") == 0) {
+            if (strcmp(argv[i+1], "low") == 0) return BLIP_QUALITY_LOW;
+            if (strcmp(argv[i+1], "medium") == 0) return BLIP_QUALITY_MEDIUM;
+            if (strcmp(argv[i+1], "high") == 0) return BLIP_QUALITY_HIGH;
+            fprintf(stderr, "Warning: unknown --audio-quality '%s'.\n", argv[i+1]);
+        }
+    }
+    return BLIP_QUALITY_MEDIUM;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Run-ahead: after each real frame, emulate `frames` more with the same
+// input, show the last, and roll back. Games that act on input a frame or
+// two late then respond on the very next displayed frame.
+typedef struct {
+    int frames;
+    uint8_t *state;
+    size_t state_size;
+    // Stats
+    uint64_t host_frames;
+    double real_sec;    // real frames
+    double extra_sec;   // save + speculative frames + load
+} RunAhead;
+
+static void run_ahead_frame(NES *nes, RunAhead *ra) {
+    double t0 = now_sec();
+    nes_save_state(nes, ra->state, ra->state_size);
+    apu_set_muted(nes->apu, true);
+    for (int i = 0; i < ra->frames; ++i) {
+        nes->ppu.skip_draw = i + 1 < ra->frames; // only the shown frame draws
+        nes_run_frame(nes);
+    }
+    nes_load_state(nes, ra->state, ra->state_size);
+    apu_set_muted(nes->apu, false);
+    // The next real frame is never shown
+    nes->ppu.skip_draw = true;
+    ra->extra_sec += now_sec() - t0;
+    ++ra->host_frames;
+}
+
+static void movie_write_failed(Movie *m, bool *on, const char *path) {
+    fprintf(stderr, "Warning: cannot write movie '%s'; recording stopped.\n", path);
+    movie_close(m);
+    *on = false;
+}
+
+static int parse_save_flush_frames(int argc, char **argv) {
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "--save-flush") == 0) return atoi(argv[i+1]);
+    }
+    return SAVE_FLUSH_FRAMES;
+}
+
+static int parse_audio_latency_ms(int argc, char **argv) {
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "--audio-latency") == 0) return atoi(argv[i+1]);
+    }
+    return 40;
+}
+
+#ifdef HAVE_SDL2
+// Block until the device has drained the ring to about one frame above the
+// target, then nudge the resampling ratio so the fill converges on target.
+// The audio clock paces emulation; the ratio absorbs the rate mismatch.
+static void audio_sync(APU *apu, AudioSink *sink, uint32_t target, uint32_t frame_samples) {
+    AudioRingStats st;
+    audio_sink_stats(sink, &st, false);
+    uint32_t waited = 0;
+    while (st.fill > target + frame_samples && waited < AUDIO_WAIT_MAX_MS) {
+        SDL_Delay(1);
+        ++waited;
+        audio_sink_stats(sink, &st, false);
+    }
+    double err = ((double)target - (double)st.fill) / (double)target;
+    if (err > 1.0) err = 1.0; else if (err < -1.0) err = -1.0;
+    apu_set_rate_ratio(apu, 1.0 + DRC_MAX_ADJUST * err);
+}
+
+// Sleep until the absolute performance-counter deadline; the last
+// millisecond is spun to get past SDL_Delay's granularity.
+static void wait_until(uint64_t deadline, uint64_t perf_freq) {
+    for (;;) {
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (now >= deadline) return;
+        uint64_t left_ms = (deadline - now) * 1000 / perf_freq;
+        if (left_ms > 1) SDL_Delay((uint32_t)(left_ms - 1));
+    }
+}
+#endif
+
 static bool parse_debug_ppu(int argc, char **argv) {
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--debug-ppu") == 0) return true;
@@ -66,6 +213,22 @@ static bool parse_no_audio(int argc, char **argv) {
     return false;
 }
 
+static bool parse_audio_stats(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--audio-stats") == 0) return true;
+    }
+    return false;
+}
+
+static void print_audio_stats(FILE *out, AudioSink *sink, const char *tag, bool reset_minmax) {
+    AudioRingStats st;
+    if (!audio_sink_stats(sink, &st, reset_minmax)) return;
+    fprintf(out, "%s ring %u/%u (min %u max %u)  underruns %llu (%llu samples)  overruns %llu (%llu samples)\n",
+           tag, st.fill, st.capacity, st.fill_min, st.fill_max,
+           (unsigned long long)st.underruns, (unsigned long long)st.underrun_samples,
+           (unsigned long long)st.overruns, (unsigned long long)st.overrun_samples);
+}
+
 static const char *parse_str_opt(int argc, char **argv, const char *flag) {
     for (int i = 1; i < argc - 1; ++i) {
         if (strcmp(argv[i], flag) == 0) return argv[i+1];
@@ -107,12 +270,137 @@ static void apply_config(Video *vid, int *fps, bool *no_audio, const char *path)
     fclose(f);
 }
 
+static bool parse_flag(int argc, char **argv, const char *flag) {
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], flag) == 0) return true;
+    }
+    return false;
+}
+
+static void print_rom_info(FILE *out, const Cartridge *c) {
+    static const char *const MIRRORS[] = { "horizontal", "vertical", "four-screen", "single-screen A", "single-screen B" };
+    static const char *const TIMINGS[] = { "NTSC", "PAL", "multi-region", "Dendy" };
+    fprintf(out, "ROM: %s, mapper %u.%u (%s), PRG ROM %uKB, CHR %s %uKB, PRG RAM %uB%s, %s mirroring, %s\n",
+            c->nes2 ? "NES 2.0" : "iNES", c->mapper, c->submapper, c->ops->name,
+            c->prg_rom_size / 1024, c->chr_is_ram ? "RAM" : "ROM", c->chr_size / 1024,
+            c->prg_ram_size, c->battery ? " (battery)" : "", MIRRORS[c->mirror], TIMINGS[c->timing]);
+    fprintf(out, "ROM CRC32: %08X%s\n", c->crc32, c->db_match ? " (header corrected from ROM database)" : "");
+}
+
+// --apu-replay: render a recorded APU log to a file sink, no ROM needed
+static int replay_apu_log(int argc, char **argv, const char *log_path) {
+    const char *wav_path = parse_str_opt(argc, argv, "--wav");
+    const char *raw_path = parse_str_opt(argc, argv, "--raw-audio");
+    int rate = parse_audio_rate(argc, argv);
+    AudioSink *sink = wav_path ? audio_sink_wav_open(wav_path, rate)
+                    : raw_path ? audio_sink_raw_open(raw_path, rate) : NULL;
+    if (!sink) {
+        fprintf(stderr, "--apu-replay needs a writable --wav or --raw-audio output.\n");
+        return 1;
+    }
+    long frames = apu_log_render(log_path, sink, parse_audio_quality(argc, argv));
+    audio_sink_close(&sink);
+    if (frames < 0) {
+        fprintf(stderr, "Cannot replay APU log '%s'%s.\n", log_path, frames == -2 ? " (not an APU log)" : "");
+        return 2;
+    }
+    fprintf(stderr, "Rendered %ld frames from '%s'.\n", frames, log_path);
+    return 0;
+}
+
+// --verify: replay a movie's keyframe segments in parallel and report each
+static int verify_movie(int argc, char **argv, const char *rom_path, const char *movie_path) {
+    const char *keys_path = parse_str_opt(argc, argv, "--keyframes");
+    if (!keys_path) {
+        fprintf(stderr, "--verify needs --keyframes FILE (written by --record or --play).\n");
+        return 1;
+    }
+    const char *rom_db = parse_str_opt(argc, argv, "--rom-db");
+    if (rom_db && romdb_load(rom_db) < 0) fprintf(stderr, "Warning: cannot read ROM database '%s'.\n", rom_db);
+    Movie movie;
+    MovieKeys keys;
+    int rc = movie_load(&movie, movie_path);
+    if (rc != 0) {
+        fprintf(stderr, "Cannot read movie '%s'%s.\n", movie_path, rc == -2 ? " (not a movie or damaged)" : "");
+        return 2;
+    }
+    rc = movie_keys_load(&keys, keys_path);
+    if (rc != 0) {
+        fprintf(stderr, "Cannot read keyframes '%s'%s.\n", keys_path, rc == -2 ? " (not a keyframe file or damaged)" : "");
+        movie_close(&movie);
+        return 2;
+    }
+
+    // Every segment forks from this one; only the ROM image is shared
+    NES base;
+    nes_init(&base);
+    rc = nes_load_rom(&base, rom_path);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to load ROM '%s' (err %d).\n", rom_path, rc);
+        nes_free(&base);
+        movie_keys_free(&keys);
+        movie_close(&movie);
+        return 2;
+    }
+    nes_reset(&base);
+    const char *threads_arg = parse_str_opt(argc, argv, "--threads");
+    ThreadPool *pool = NULL;
+    MovieSegment *segs = (MovieSegment*)malloc((keys.count ? keys.count : 1) * sizeof(MovieSegment));
+    int status = 2;
+    if (!movie_play_start(&movie, &base)) {
+        fprintf(stderr, "Movie '%s' was recorded with a different ROM.\n", movie_path);
+    } else if (!segs || !(pool = threadpool_create(threads_arg ? atoi(threads_arg) : 0))) {
+        fprintf(stderr, "Out of memory.\n");
+    } else {
+        double t0 = now_sec();
+        bool ok = movie_verify_segments(&movie, &keys, &base, pool, segs);
+        double wall = now_sec() - t0;
+        if (!ok) {
+            fprintf(stderr, "Keyframes '%s' do not belong to movie '%s' or this build, or do not start at frame 0.\n",
+                    keys_path, movie_path);
+        } else {
+            size_t failed = 0;
+            double busy = 0.0;
+            printf("Segment  Frames                 Result\n");
+            for (size_t i = 0; i < keys.count; ++i) {
+                const MovieSegment *s = &segs[i];
+                busy += s->seconds;
+                printf("%7zu  %9llu-%-9llu    ", i, (unsigned long long)s->first_frame, (unsigned long long)s->end_frame);
+                if (s->pass) printf("pass  %8.1f ms\n", s->seconds * 1000.0);
+                else if (s->bad_state) printf("FAIL  keyframe does not load\n");
+                else printf("FAIL  frame %llu: hash %016llx, expected %016llx\n", (unsigned long long)s->diverged_frame,
+                            (unsigned long long)s->got_hash, (unsigned long long)s->want_hash);
+                failed += !s->pass;
+            }
+            printf("%zu segments, %llu frames, %zu failed; %.2f s on %d threads (%.2f s CPU, %.1fx).\n",
+                   keys.count, (unsigned long long)movie.frame_count, failed, wall, threadpool_size(pool), busy,
+                   wall > 0 ? busy / wall : 0.0);
+            status = failed ? 3 : 0;
+        }
+    }
+    threadpool_destroy(pool);
+    free(segs);
+    nes_free(&base);
+    movie_keys_free(&keys);
+    movie_close(&movie);
+    return status;
+}
+
 int main(int argc, char **argv) {
+    const char *apu_replay = parse_str_opt(argc, argv, "--apu-replay");
+    if (apu_replay) return replay_apu_log(argc, argv, apu_replay);
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <rom.nes> [--frames N] [--trace-ins N] [--trace-frames N] [--sdl] [--no-audio] [--fps N] [--p1map CSV] [--p2map CSV] [--config FILE] [--debug-ppu] [--bg-fallback]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <rom.nes> [--frames N] [--trace-ins N] [--trace-frames N] [--sdl] [--no-audio] [--fps N] [--p1map CSV] [--p2map CSV] [--config FILE] [--debug-ppu] [--bg-fallback] [--audio-stats] [--sync audio|timer|none] [--audio-latency MS] [--wav FILE] [--raw-audio FILE|-]\n"
+               "       [--audio-rate HZ] [--audio-quality low|medium|high] [--apu-log FILE] [--rom-db FILE] [--rom-info] [--save-flush FRAMES]\n"
+               "       [--rewind MB] [--rewind-interval FRAMES] [--run-ahead N] [--record FILE [--hash-interval FRAMES]] [--play FILE]\n"
+               "       [--keyframes FILE [--keyframe-interval FRAMES]]\n"
+               "       %s <rom.nes> --verify MOVIE --keyframes FILE [--threads N]\n"
+               "       %s --apu-replay FILE --wav FILE|--raw-audio FILE|- [--audio-rate HZ] [--audio-quality Q]\n", argv[0], argv[0], argv[0]);
         return 1;
     }
     const char *rom_path = argv[1];
+    const char *verify_path = parse_str_opt(argc, argv, "--verify");
+    if (verify_path) return verify_movie(argc, argv, rom_path, verify_path);
     int frames_to_run = parse_frames_arg(argc, argv);
     if (frames_to_run < 0) frames_to_run = 300; // default ~5s at 60fps
     int trace_ins = parse_trace_ins(argc, argv);
@@ -120,40 +408,114 @@ int main(int argc, char **argv) {
     bool want_sdl = parse_use_sdl(argc, argv);
     bool no_audio = parse_no_audio(argc, argv);
     int fps = parse_fps(argc, argv);
-    if (fps <= 0) fps = 30;
+    if (fps < 0) fps = 0;
     const char *p1map = parse_str_opt(argc, argv, "--p1map");
     const char *p2map = parse_str_opt(argc, argv, "--p2map");
     const char *cfg = parse_str_opt(argc, argv, "--config");
     bool debug_ppu = parse_debug_ppu(argc, argv);
     bool bg_fallback = parse_bg_fallback(argc, argv);
+    bool audio_stats = parse_audio_stats(argc, argv);
+    const char *wav_path = parse_str_opt(argc, argv, "--wav");
+    const char *raw_path = parse_str_opt(argc, argv, "--raw-audio");
+    // Keep stdout clean when it carries PCM
+    FILE *log = (raw_path && strcmp(raw_path, "-") == 0) ? stderr : stdout;
+
+    const char *apu_log = parse_str_opt(argc, argv, "--apu-log");
+    const char *rom_db = parse_str_opt(argc, argv, "--rom-db");
+    if (rom_db && romdb_load(rom_db) < 0) fprintf(stderr, "Warning: cannot read ROM database '%s'.\n", rom_db);
 
     NES nes;
-    nes_init(&nes, !no_audio);
+    nes_init(&nes);
+    if (apu_log && !apu_record_start(nes.apu, apu_log)) fprintf(stderr, "Warning: cannot record APU log '%s'.\n", apu_log);
     if (debug_ppu) {
-        ppu_set_debug(true);
+        ppu_set_debug(&nes.ppu, true);
     }
     int rc = nes_load_rom(&nes, rom_path);
     if (rc != 0) {
-        fprintf(stderr, "Failed to load ROM '%s' (err %d). Only iNES mapper 0 is supported.\n", rom_path, rc);
+        fprintf(stderr, "Failed to load ROM '%s' (err %d). Supported mappers: 0-4, 7.\n", rom_path, rc);
         return 2;
     }
     nes_reset(&nes);
+    if (parse_flag(argc, argv, "--rom-info")) print_rom_info(log, &nes.cart);
+    if (nes.cart.battery && nes.cart.prg_ram && !nes.cart.sav_mapped)
+        fprintf(stderr, "Warning: cannot open a save file for '%s'; battery RAM will not persist.\n", rom_path);
+    int save_flush = parse_save_flush_frames(argc, argv);
+    int since_flush = 0;
+
+    // Input movie: record the pads from here on, or replay and check them
+    Movie movie;
+    bool movie_on = false;
+    const char *record_path = parse_str_opt(argc, argv, "--record");
+    const char *play_path = parse_str_opt(argc, argv, "--play");
+    // Traced instructions run before frame 0 and are not in the movie, so a
+    // recording would start from a state playback never reaches
+    if ((play_path || record_path) && trace_ins > 0) {
+        fprintf(stderr, "--trace-ins cannot be combined with --record or --play.\n");
+        return 2;
+    }
+    if (play_path) {
+        int mrc = movie_load(&movie, play_path);
+        if (mrc != 0) {
+            fprintf(stderr, "Cannot play movie '%s'%s.\n", play_path, mrc == -2 ? " (not a movie or damaged)" : "");
+            return 2;
+        }
+        if (!movie_play_start(&movie, &nes)) {
+            fprintf(stderr, "Movie '%s' was recorded with a different ROM.\n", play_path);
+            movie_close(&movie);
+            return 2;
+        }
+        movie_on = true;
+        if (parse_frames_arg(argc, argv) < 0 || (uint64_t)frames_to_run > movie.frame_count)
+            frames_to_run = movie.frame_count > INT_MAX ? INT_MAX : (int)movie.frame_count;
+    } else if (record_path) {
+        const char *every = parse_str_opt(argc, argv, "--hash-interval");
+        int interval = every ? atoi(every) : MOVIE_DEFAULT_HASH_INTERVAL;
+        movie_on = movie_record_start(&movie, record_path, &nes, interval > 0 ? (uint32_t)interval : MOVIE_DEFAULT_HASH_INTERVAL);
+        if (!movie_on) fprintf(stderr, "Warning: cannot record movie '%s'.\n", record_path);
+    }
+    const char *keys_path = parse_str_opt(argc, argv, "--keyframes");
+    if (movie_on && keys_path) {
+        const char *every = parse_str_opt(argc, argv, "--keyframe-interval");
+        int interval = every ? atoi(every) : MOVIE_DEFAULT_KEYFRAME_INTERVAL;
+        if (!movie_keys_start(&movie, keys_path, &nes, interval > 0 ? (uint32_t)interval : MOVIE_DEFAULT_KEYFRAME_INTERVAL))
+            fprintf(stderr, "Warning: cannot write keyframes '%s'.\n", keys_path);
+    }
+
+    // Run-ahead (speculative frames, rolled back every host frame)
+    RunAhead ahead = { 0 };
+    const char *ahead_arg = parse_str_opt(argc, argv, "--run-ahead");
+    if (ahead_arg && atoi(ahead_arg) > 0) {
+        ahead.frames = atoi(ahead_arg);
+        ahead.state_size = nes_state_size(&nes);
+        ahead.state = (uint8_t*)malloc(ahead.state_size);
+        if (!ahead.state) { fprintf(stderr, "Warning: run-ahead disabled (out of memory).\n"); ahead.frames = 0; }
+        nes.ppu.skip_draw = ahead.frames > 0;
+    }
+
+    // Rewind history (hold Backspace in the window to step back)
+    Rewind rewind;
+    bool rewind_on = false, rewinding = false;
+    const char *rewind_mb = parse_str_opt(argc, argv, "--rewind");
+    if (rewind_mb) {
+        const char *every = parse_str_opt(argc, argv, "--rewind-interval");
+        int interval = every ? atoi(every) : REWIND_DEFAULT_INTERVAL;
+        rewind_on = atoi(rewind_mb) > 0 && rewind_init(&rewind, &nes, (size_t)atoi(rewind_mb) << 20, interval);
+        if (!rewind_on) fprintf(stderr, "Warning: cannot set up a %s MB rewind buffer.\n", rewind_mb);
+    }
 
     // Optional instruction trace first
     if (trace_ins > 0) {
-        printf("Tracing %d instructions...\n", trace_ins);
+        fprintf(log, "Tracing %d instructions...\n", trace_ins);
         for (int i = 0; i < trace_ins; ++i) {
             uint16_t pc = nes.cpu.PC;
             uint8_t op = bus_cpu_read(&nes.bus, pc);
             int used = nes_step_instruction(&nes);
-            printf("ins %6d  PC:%04X OP:%02X  A:%02X X:%02X Y:%02X P:%02X S:%02X  cyc+%d\n",
+            fprintf(log, "ins %6d  PC:%04X OP:%02X  A:%02X X:%02X Y:%02X P:%02X S:%02X  cyc+%d\n",
                    i+1, pc, op, nes.cpu.A, nes.cpu.X, nes.cpu.Y, nes.cpu.P, nes.cpu.S, used);
         }
     }
 
-    // Simple run loop: cycles per frame ≈ 29830
-    const int cycles_per_frame = 29830;
-    printf("Running %d frames...\n", frames_to_run);
+    fprintf(log, "Running %d frames...\n", frames_to_run);
 
     clock_t start = clock();
     // Optional SDL window
@@ -162,7 +524,7 @@ int main(int argc, char **argv) {
     if (want_sdl) {
         have_window = video_init(&vid, "NES-EMU", 256, 240, 3);
         if (!have_window) {
-            printf("SDL2 not available; continuing headless.\n");
+            fprintf(log, "SDL2 not available; continuing headless.\n");
         }
         // Apply config file mappings and settings if provided
         if (cfg) apply_config(vid, &fps, &no_audio, cfg);
@@ -180,22 +542,85 @@ int main(int argc, char **argv) {
         }
     }
 
-    const double target_ms = 1000.0 / (double)fps; // FPS limiter
+    // Audio output: file sinks take precedence over the SDL device
+    AudioSink *sink = NULL;
+    int audio_rate = parse_audio_rate(argc, argv);
+    if (wav_path) {
+        sink = audio_sink_wav_open(wav_path, audio_rate);
+        if (!sink) fprintf(stderr, "Warning: cannot write WAV '%s'.\n", wav_path);
+    } else if (raw_path) {
+        sink = audio_sink_raw_open(raw_path, audio_rate);
+        if (!sink) fprintf(stderr, "Warning: cannot write raw audio '%s'.\n", raw_path);
+    } else if (!no_audio) {
+        sink = audio_sink_sdl_open(audio_rate, AUDIO_RING_SAMPLES);
+    }
+    apu_set_resampler_quality(nes.apu, parse_audio_quality(argc, argv));
+    if (sink && !apu_set_sink(nes.apu, sink)) audio_sink_close(&sink);
+
+    // Pace on a real-time audio device when there is one, otherwise on a
+    // timer; file sinks without a window run as fast as possible. An
+    // explicit --fps means a fixed display rate, so it implies timer sync.
+    bool realtime_audio = sink && sink->realtime;
+    SyncMode sync = parse_sync(argc, argv, realtime_audio && fps == 0 ? SYNC_AUDIO
+                                          : (sink && !realtime_audio && !have_window) ? SYNC_NONE : SYNC_TIMER);
+    if (sync == SYNC_AUDIO && !realtime_audio) sync = SYNC_TIMER;
+    #ifdef HAVE_SDL2
+    const double frame_hz = fps > 0 ? (double)fps : NTSC_FRAME_HZ;
+    const uint64_t perf_freq = SDL_GetPerformanceFrequency();
+    const uint64_t frame_ticks = (uint64_t)((double)perf_freq / frame_hz);
+    uint64_t deadline = SDL_GetPerformanceCounter();
+    uint32_t audio_target = 0, frame_samples = 0;
+    if (realtime_audio) {
+        int rate = sink->sample_rate;
+        audio_target = (uint32_t)((int64_t)rate * parse_audio_latency_ms(argc, argv) / 1000);
+        if (audio_target == 0) audio_target = 1;
+        frame_samples = (uint32_t)((double)rate / NTSC_FRAME_HZ);
+    }
+    #else
+    (void)parse_audio_latency_ms;
+    #endif
     for (int f = 0; f < frames_to_run; ++f) {
+        // While rewinding, each frame starts from the next older snapshot
+        // and runs once to redraw it
+        bool stepped = rewinding && rewind_step_back(&rewind, &nes);
+        if (movie_on && !movie_begin_frame(&movie, &nes)) {
+            if (play_path) break; // end of the movie
+            movie_write_failed(&movie, &movie_on, record_path);
+        }
+        double frame_start = ahead.frames ? now_sec() : 0.0;
+        nes_run_frame(&nes);
+        apu_end_frame(nes.apu);
+        if (movie_on && !movie_end_frame(&movie, &nes)) {
+            if (movie.diverged) break;
+            movie_write_failed(&movie, &movie_on, record_path);
+        }
+        if (rewind_on && !stepped) rewind_frame(&rewind, &nes);
+        if (ahead.frames) {
+            ahead.real_sec += now_sec() - frame_start;
+            run_ahead_frame(&nes, &ahead);
+        }
         #ifdef HAVE_SDL2
-        uint32_t t0 = SDL_GetTicks();
+        if (sync == SYNC_AUDIO) audio_sync(nes.apu, sink, audio_target, frame_samples);
         #endif
-        nes_run_cycles(&nes, cycles_per_frame);
+        if (audio_stats && (f + 1) % 60 == 0) print_audio_stats(log, sink, "audio:", true);
+        // Only dirty pages are written, and only every few frames, so a game
+        // hammering its save RAM costs one small msync a second
+        if (nes.cart.sav_dirty && ++since_flush >= save_flush) {
+            if (!cart_save_flush(&nes.cart)) fprintf(stderr, "Warning: save file write failed; will retry.\n");
+            since_flush = 0;
+        }
 
         if (trace_frames > 0 && f < trace_frames) {
-            printf("frame %5d  PC:%04X  A:%02X X:%02X Y:%02X P:%02X S:%02X\n",
+            fprintf(log, "frame %5d  PC:%04X  A:%02X X:%02X Y:%02X P:%02X S:%02X\n",
                    f+1, nes.cpu.PC, nes.cpu.A, nes.cpu.X, nes.cpu.Y, nes.cpu.P, nes.cpu.S);
         }
 
         if (have_window) {
             bool quit = false;
             uint8_t pad1 = 0, pad2 = 0;
-            video_poll(vid, &quit, &pad1, &pad2);
+            video_poll(vid, &quit, &pad1, &pad2, &rewinding);
+            // A movie cannot follow a jump back in time
+            rewinding = rewinding && rewind_on && !movie_on;
             controller_set_state(&nes.ctrl1, pad1);
             controller_set_state(&nes.ctrl2, pad2);
             if (quit) break;
@@ -209,19 +634,58 @@ int main(int argc, char **argv) {
         }
 
         #ifdef HAVE_SDL2
-        uint32_t elapsed = SDL_GetTicks() - t0;
-        if (elapsed < (uint32_t)target_ms) {
-            SDL_Delay((uint32_t)(target_ms - elapsed));
+        if (sync == SYNC_TIMER) {
+            // Absolute deadlines so rounding never accumulates into drift
+            deadline += frame_ticks;
+            uint64_t now = SDL_GetPerformanceCounter();
+            if (now > deadline + frame_ticks) deadline = now; // fell behind; resync
+            else wait_until(deadline, perf_freq);
         }
+        #else
+        (void)sync;
         #endif
     }
     clock_t end = clock();
     double secs = (double)(end - start) / CLOCKS_PER_SEC;
-    printf("Done. Ran %d frames in %.2f seconds.\n", frames_to_run, secs);
+    fprintf(log, "Done. Ran %d frames in %.2f seconds.\n", frames_to_run, secs);
     (void)secs;
+    print_audio_stats(log, sink, "Audio:", false);
+    if (ahead.frames) {
+        double n = ahead.host_frames ? (double)ahead.host_frames : 1.0;
+        fprintf(log, "Run-ahead: %d frames, overhead %.2f ms per host frame (real frame %.2f ms, +%.0f%%)\n",
+                ahead.frames, ahead.extra_sec / n * 1000.0, ahead.real_sec / n * 1000.0,
+                ahead.real_sec > 0 ? ahead.extra_sec / ahead.real_sec * 100.0 : 0.0);
+        free(ahead.state);
+    }
+    if (rewind_on) {
+        uint64_t n = rewind.snapshots ? rewind.snapshots : 1;
+        fprintf(log, "Rewind: %llu snapshots, %zu held, avg %.0f bytes packed (state %zu), avg %.1f us each\n",
+                (unsigned long long)rewind.snapshots, rewind_depth(&rewind), (double)rewind.packed_bytes / (double)n,
+                rewind.state_size, (double)rewind.snapshot_ns / (double)n / 1000.0);
+        rewind_free(&rewind);
+    }
+
+    int status = 0;
+    if (movie_on && play_path) {
+        if (movie.diverged) {
+            // Checks are hash_interval apart, so the difference arose after
+            // the previous one
+            fprintf(log, "Movie diverged at frame %llu: state hash %016llx, recorded %016llx (matched through frame %llu).\n",
+                    (unsigned long long)movie.diverged_frame, (unsigned long long)movie.got_hash,
+                    (unsigned long long)movie.want_hash, (unsigned long long)(movie.diverged_frame - movie.hash_interval));
+            status = 3;
+        } else {
+            fprintf(log, "Movie: %llu of %llu frames played, %llu state hashes matched.\n",
+                    (unsigned long long)movie.frame, (unsigned long long)movie.frame_count,
+                    (unsigned long long)movie.hashes_checked);
+        }
+    }
+    if (movie_on && !movie_close(&movie))
+        fprintf(stderr, "Warning: movie or keyframe file may be incomplete.\n");
 
-    if (nes.apu) apu_shutdown(&nes.apu);
+    apu_set_sink(nes.apu, NULL);
+    audio_sink_close(&sink);
+    nes_free(&nes);
     if (vid) video_shutdown(&vid);
-    cartridge_free(&nes.cart);
-    return 0;
+    return status;
 }
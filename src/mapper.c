@@ -0,0 +1,130 @@
+#include "mapper.h"
+#include <string.h>
+
+#define PRG_BANK_8K (8 * 1024u)
+#define CHR_BANK_1K 1024u
+
+static const Mapper *const MAPPERS[] = {
+    &MAPPER_NROM, &MAPPER_MMC1, &MAPPER_UXROM, &MAPPER_CNROM, &MAPPER_MMC3, &MAPPER_AXROM,
+};
+
+const Mapper *mapper_find(uint16_t id) {
+    for (size_t i = 0; i < sizeof(MAPPERS) / sizeof(MAPPERS[0]); ++i) {
+        if (MAPPERS[i]->id == id) return MAPPERS[i];
+    }
+    return NULL;
+}
+
+static int wrap_bank(int bank, uint32_t count) {
+    if (count == 0) return 0;
+    int n = (int)count;
+    bank %= n;
+    return bank < 0 ? bank + n : bank;
+}
+
+void mapper_map_prg8(Cartridge *c, int slot, int bank) {
+    bank = wrap_bank(bank, c->prg_rom_size / PRG_BANK_8K);
+    c->prg_map[slot & 3] = c->prg_rom + (uint32_t)bank * PRG_BANK_8K;
+}
+
+void mapper_map_prg16(Cartridge *c, int slot, int bank) {
+    bank = wrap_bank(bank, c->prg_rom_size / (2 * PRG_BANK_8K));
+    mapper_map_prg8(c, slot * 2, bank * 2);
+    mapper_map_prg8(c, slot * 2 + 1, bank * 2 + 1);
+}
+
+void mapper_map_prg32(Cartridge *c, int bank) {
+    // 16KB images mirror into both halves
+    if (c->prg_rom_size < 4 * PRG_BANK_8K) { mapper_map_prg16(c, 0, 0); mapper_map_prg16(c, 1, 0); return; }
+    bank = wrap_bank(bank, c->prg_rom_size / (4 * PRG_BANK_8K));
+    for (int i = 0; i < 4; ++i) mapper_map_prg8(c, i, bank * 4 + i);
+}
+
+void mapper_map_chr1(Cartridge *c, int slot, int bank) {
+    bank = wrap_bank(bank, c->chr_size / CHR_BANK_1K);
+    c->chr_map[slot & 7] = c->chr + (uint32_t)bank * CHR_BANK_1K;
+}
+
+void mapper_map_chr2(Cartridge *c, int slot, int bank) {
+    for (int i = 0; i < 2; ++i) mapper_map_chr1(c, slot * 2 + i, bank * 2 + i);
+}
+
+void mapper_map_chr4(Cartridge *c, int slot, int bank) {
+    for (int i = 0; i < 4; ++i) mapper_map_chr1(c, slot * 4 + i, bank * 4 + i);
+}
+
+void mapper_map_chr8(Cartridge *c, int bank) {
+    for (int i = 0; i < 8; ++i) mapper_map_chr1(c, i, bank * 8 + i);
+}
+
+size_t mapper_save_regs(const Cartridge *c, void *buf) {
+    memcpy(buf, &c->regs, c->ops->state_size);
+    return c->ops->state_size;
+}
+
+bool mapper_load_regs(Cartridge *c, const void *buf, size_t len) {
+    if (len != c->ops->state_size) return false;
+    memcpy(&c->regs, buf, len);
+    c->ops->sync(c);
+    return true;
+}
+
+// Mapper 0: fixed 16KB or 32KB PRG, 8KB CHR
+static void nrom_reset(Cartridge *c) { (void)c; }
+
+static void nrom_sync(Cartridge *c) {
+    mapper_map_prg32(c, 0);
+    mapper_map_chr8(c, 0);
+}
+
+const Mapper MAPPER_NROM = {
+    .id = 0, .name = "NROM",
+    .reset = nrom_reset, .sync = nrom_sync,
+    .state_size = 0, .save_state = mapper_save_regs, .load_state = mapper_load_regs,
+};
+
+// Mapper 2: switchable 16KB at $8000, last 16KB fixed at $C000
+static void latch_reset(Cartridge *c) { c->regs.latch.bank = 0; }
+
+static void latch_write(Cartridge *c, uint16_t addr, uint8_t data) {
+    (void)addr;
+    c->regs.latch.bank = data;
+    c->ops->sync(c);
+}
+
+static void uxrom_sync(Cartridge *c) {
+    mapper_map_prg16(c, 0, c->regs.latch.bank);
+    mapper_map_prg16(c, 1, -1);
+    mapper_map_chr8(c, 0);
+}
+
+const Mapper MAPPER_UXROM = {
+    .id = 2, .name = "UxROM",
+    .reset = latch_reset, .sync = uxrom_sync, .cpu_write = latch_write,
+    .state_size = sizeof(((MapperRegs*)0)->latch), .save_state = mapper_save_regs, .load_state = mapper_load_regs,
+};
+
+// Mapper 3: fixed PRG, switchable 8KB CHR
+static void cnrom_sync(Cartridge *c) {
+    mapper_map_prg32(c, 0);
+    mapper_map_chr8(c, c->regs.latch.bank & 3);
+}
+
+const Mapper MAPPER_CNROM = {
+    .id = 3, .name = "CNROM",
+    .reset = latch_reset, .sync = cnrom_sync, .cpu_write = latch_write,
+    .state_size = sizeof(((MapperRegs*)0)->latch), .save_state = mapper_save_regs, .load_state = mapper_load_regs,
+};
+
+// Mapper 7: switchable 32KB PRG, single-screen mirroring select
+static void axrom_sync(Cartridge *c) {
+    mapper_map_prg32(c, c->regs.latch.bank & 7);
+    mapper_map_chr8(c, 0);
+    c->mirror = (c->regs.latch.bank & 0x10) ? MIRROR_SINGLE_HIGH : MIRROR_SINGLE_LOW;
+}
+
+const Mapper MAPPER_AXROM = {
+    .id = 7, .name = "AxROM",
+    .reset = latch_reset, .sync = axrom_sync, .cpu_write = latch_write,
+    .state_size = sizeof(((MapperRegs*)0)->latch), .save_state = mapper_save_regs, .load_state = mapper_load_regs,
+};
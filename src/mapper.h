@@ -0,0 +1,57 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "cartridge.h"
+
+// Cartridge mapper: bank-switching hardware behind a small vtable. Every
+// mapper keeps cart->prg_map/chr_map pointing at the current banks; the bus
+// and PPU read through those tables directly, so only register writes and
+// the hooks below go through function pointers.
+struct Mapper {
+    uint16_t id;        // iNES mapper number
+    const char *name;
+    // Power-on register values (banks are then applied with sync)
+    void (*reset)(Cartridge *c);
+    // Re-derive the bank tables and mirroring from cart->regs
+    void (*sync)(Cartridge *c);
+    // Optional overrides of the table-driven paths (NULL for the mappers
+    // shipped here): reads at $8000-$FFFF and pattern table access
+    uint8_t (*cpu_read)(Cartridge *c, uint16_t addr);
+    uint8_t (*ppu_read)(Cartridge *c, uint16_t addr);
+    void (*ppu_write)(Cartridge *c, uint16_t addr, uint8_t data);
+    // Register write at $8000-$FFFF
+    void (*cpu_write)(Cartridge *c, uint16_t addr, uint8_t data);
+    // PPU address line A12 rose (pattern fetches moved from the $0xxx to
+    // the $1xxx table). The PPU works the edges out per scanline and calls
+    // this on their exact dots; NULL if the mapper does not watch A12.
+    void (*a12_rise)(Cartridge *c);
+    // Bank state for save states; load re-applies the banks
+    size_t state_size;
+    size_t (*save_state)(const Cartridge *c, void *buf);
+    bool (*load_state)(Cartridge *c, const void *buf, size_t len);
+};
+
+// NULL if the mapper number is not supported
+const Mapper *mapper_find(uint16_t id);
+
+// Bank helpers: bank numbers wrap to the ROM (or CHR RAM) size; negative
+// numbers count from the last bank
+void mapper_map_prg8(Cartridge *c, int slot, int bank);
+void mapper_map_prg16(Cartridge *c, int slot, int bank);
+void mapper_map_prg32(Cartridge *c, int bank);
+void mapper_map_chr1(Cartridge *c, int slot, int bank);
+void mapper_map_chr2(Cartridge *c, int slot, int bank);
+void mapper_map_chr4(Cartridge *c, int slot, int bank);
+void mapper_map_chr8(Cartridge *c, int bank);
+
+// save_state/load_state for mappers whose state is just MapperRegs
+size_t mapper_save_regs(const Cartridge *c, void *buf);
+bool mapper_load_regs(Cartridge *c, const void *buf, size_t len);
+
+extern const Mapper MAPPER_NROM;
+extern const Mapper MAPPER_MMC1;
+extern const Mapper MAPPER_UXROM;
+extern const Mapper MAPPER_CNROM;
+extern const Mapper MAPPER_MMC3;
+extern const Mapper MAPPER_AXROM;
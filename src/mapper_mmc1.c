@@ -0,0 +1,62 @@
+#include "mapper.h"
+
+// Mapper 1 (MMC1): registers are loaded through a 5-bit serial port.
+// control: bits 0-1 mirroring, bits 2-3 PRG mode, bit 4 CHR mode.
+
+static void mmc1_reset(Cartridge *c) {
+    c->regs.mmc1.shift = 0;
+    c->regs.mmc1.count = 0;
+    c->regs.mmc1.control = 0x0C; // PRG mode 3: last bank fixed at $C000
+    c->regs.mmc1.chr0 = 0;
+    c->regs.mmc1.chr1 = 0;
+    c->regs.mmc1.prg = 0;
+}
+
+static void mmc1_sync(Cartridge *c) {
+    static const MirrorMode MIRROR[4] = {
+        MIRROR_SINGLE_LOW, MIRROR_SINGLE_HIGH, MIRROR_VERTICAL, MIRROR_HORIZONTAL
+    };
+    uint8_t control = c->regs.mmc1.control;
+    c->mirror = MIRROR[control & 3];
+    int prg = c->regs.mmc1.prg & 0x0F;
+    switch ((control >> 2) & 3) {
+        case 0: case 1: mapper_map_prg32(c, prg >> 1); break;
+        case 2: mapper_map_prg16(c, 0, 0); mapper_map_prg16(c, 1, prg); break;
+        case 3: mapper_map_prg16(c, 0, prg); mapper_map_prg16(c, 1, -1); break;
+    }
+    if (control & 0x10) {
+        mapper_map_chr4(c, 0, c->regs.mmc1.chr0);
+        mapper_map_chr4(c, 1, c->regs.mmc1.chr1);
+    } else {
+        mapper_map_chr8(c, c->regs.mmc1.chr0 >> 1);
+    }
+}
+
+static void mmc1_write(Cartridge *c, uint16_t addr, uint8_t data) {
+    if (data & 0x80) {
+        // Reset the shift register and return to PRG mode 3
+        c->regs.mmc1.shift = 0;
+        c->regs.mmc1.count = 0;
+        c->regs.mmc1.control |= 0x0C;
+        mmc1_sync(c);
+        return;
+    }
+    c->regs.mmc1.shift |= (uint8_t)((data & 1) << c->regs.mmc1.count);
+    if (++c->regs.mmc1.count < 5) return;
+    uint8_t value = c->regs.mmc1.shift;
+    c->regs.mmc1.shift = 0;
+    c->regs.mmc1.count = 0;
+    switch ((addr >> 13) & 3) {
+        case 0: c->regs.mmc1.control = value; break;
+        case 1: c->regs.mmc1.chr0 = value; break;
+        case 2: c->regs.mmc1.chr1 = value; break;
+        case 3: c->regs.mmc1.prg = value; break;
+    }
+    mmc1_sync(c);
+}
+
+const Mapper MAPPER_MMC1 = {
+    .id = 1, .name = "MMC1",
+    .reset = mmc1_reset, .sync = mmc1_sync, .cpu_write = mmc1_write,
+    .state_size = sizeof(((MapperRegs*)0)->mmc1), .save_state = mapper_save_regs, .load_state = mapper_load_regs,
+};
@@ -0,0 +1,76 @@
+#include "mapper.h"
+
+// Mapper 4 (MMC3): eight bank registers selected through $8000, PRG and
+// CHR layout modes, switchable mirroring and a scanline IRQ counter clocked
+// by PPU A12 rising edges.
+
+static void mmc3_reset(Cartridge *c) {
+    static const uint8_t R_INIT[8] = { 0, 2, 4, 5, 6, 7, 0, 1 };
+    c->regs.mmc3.select = 0;
+    for (int i = 0; i < 8; ++i) c->regs.mmc3.r[i] = R_INIT[i];
+    c->regs.mmc3.mirror = 0;
+    c->regs.mmc3.irq_latch = 0;
+    c->regs.mmc3.irq_counter = 0;
+    c->regs.mmc3.irq_enabled = false;
+    c->regs.mmc3.irq_reload = false;
+}
+
+static void mmc3_sync(Cartridge *c) {
+    const uint8_t *r = c->regs.mmc3.r;
+    // PRG mode (bit 6) swaps which of $8000/$C000 is fixed to the
+    // second-to-last bank
+    int swap = (c->regs.mmc3.select & 0x40) ? 2 : 0;
+    mapper_map_prg8(c, 0 ^ swap, r[6] & 0x3F);
+    mapper_map_prg8(c, 1, r[7] & 0x3F);
+    mapper_map_prg8(c, 2 ^ swap, -2);
+    mapper_map_prg8(c, 3, -1);
+    // CHR mode (bit 7) swaps the 2KB and 1KB halves
+    int half = (c->regs.mmc3.select & 0x80) ? 4 : 0;
+    mapper_map_chr1(c, 0 ^ half, r[0] & 0xFE);
+    mapper_map_chr1(c, 1 ^ half, r[0] | 0x01);
+    mapper_map_chr1(c, 2 ^ half, r[1] & 0xFE);
+    mapper_map_chr1(c, 3 ^ half, r[1] | 0x01);
+    for (int i = 0; i < 4; ++i) mapper_map_chr1(c, (4 + i) ^ half, r[2 + i]);
+    if (c->mirror != MIRROR_FOUR) c->mirror = (c->regs.mmc3.mirror & 1) ? MIRROR_HORIZONTAL : MIRROR_VERTICAL;
+}
+
+static void mmc3_write(Cartridge *c, uint16_t addr, uint8_t data) {
+    bool odd = (addr & 1) != 0;
+    switch (addr & 0xE000) {
+        case 0x8000:
+            if (odd) c->regs.mmc3.r[c->regs.mmc3.select & 7] = data;
+            else c->regs.mmc3.select = data;
+            mmc3_sync(c);
+            break;
+        case 0xA000:
+            // Odd: PRG RAM protect, not modelled (RAM always enabled)
+            if (!odd) { c->regs.mmc3.mirror = data; mmc3_sync(c); }
+            break;
+        case 0xC000:
+            if (odd) { c->regs.mmc3.irq_counter = 0; c->regs.mmc3.irq_reload = true; }
+            else c->regs.mmc3.irq_latch = data;
+            break;
+        case 0xE000:
+            c->regs.mmc3.irq_enabled = odd;
+            if (!odd) c->irq = false; // disabling also acknowledges
+            break;
+    }
+}
+
+// Scanline counter, clocked by each (filtered) A12 rising edge; the IRQ
+// asserts on the edge that takes it to zero
+static void mmc3_a12_rise(Cartridge *c) {
+    if (c->regs.mmc3.irq_counter == 0 || c->regs.mmc3.irq_reload) {
+        c->regs.mmc3.irq_counter = c->regs.mmc3.irq_latch;
+        c->regs.mmc3.irq_reload = false;
+    } else {
+        c->regs.mmc3.irq_counter--;
+    }
+    if (c->regs.mmc3.irq_counter == 0 && c->regs.mmc3.irq_enabled) c->irq = true;
+}
+
+const Mapper MAPPER_MMC3 = {
+    .id = 4, .name = "MMC3",
+    .reset = mmc3_reset, .sync = mmc3_sync, .cpu_write = mmc3_write, .a12_rise = mmc3_a12_rise,
+    .state_size = sizeof(((MapperRegs*)0)->mmc3), .save_state = mapper_save_regs, .load_state = mapper_load_regs,
+};
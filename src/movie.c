@@ -0,0 +1,337 @@
+#define _POSIX_C_SOURCE 200809L
+#include "movie.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char MOVIE_MAGIC[8] = { 'N','E','S','M','O','V','I','E' };
+#define MOVIE_VERSION 1
+#define MOVIE_HEADER_SIZE 24
+static const char KEYS_MAGIC[8] = { 'N','E','S','K','E','Y','S','\0' };
+#define KEYS_VERSION 1
+#define KEYS_HEADER_SIZE 24
+#define KEYS_RECORD_HEADER 16
+
+static void put_u32(uint8_t *out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void put_u64(uint8_t *out, uint64_t v) {
+    put_u32(out, (uint32_t)v);
+    put_u32(out + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t get_u32(const uint8_t *in) {
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+static uint64_t get_u64(const uint8_t *in) {
+    return (uint64_t)get_u32(in) | (uint64_t)get_u32(in + 4) << 32;
+}
+
+bool movie_record_start(Movie *m, const char *path, const NES *nes, uint32_t hash_interval) {
+    memset(m, 0, sizeof(*m));
+    m->hash_interval = hash_interval ? hash_interval : 1;
+    m->out = fopen(path, "wb");
+    if (!m->out) return false;
+    uint8_t header[MOVIE_HEADER_SIZE];
+    memcpy(header, MOVIE_MAGIC, sizeof(MOVIE_MAGIC));
+    put_u32(header + 8, MOVIE_VERSION);
+    put_u32(header + 12, nes->cart.crc32);
+    put_u32(header + 16, m->hash_interval);
+    put_u32(header + 20, nes->cart.prg_ram ? nes->cart.prg_ram_size : 0);
+    bool ok = fwrite(header, sizeof(header), 1, m->out) == 1;
+    if (ok && nes->cart.prg_ram) ok = fwrite(nes->cart.prg_ram, nes->cart.prg_ram_size, 1, m->out) == 1;
+    if (!ok) { fclose(m->out); m->out = NULL; }
+    return ok;
+}
+
+// Decode a whole movie file into m
+static int movie_parse(Movie *m, const uint8_t *data, size_t size) {
+    if (size < MOVIE_HEADER_SIZE || memcmp(data, MOVIE_MAGIC, sizeof(MOVIE_MAGIC)) != 0 ||
+        get_u32(data + 8) != MOVIE_VERSION || get_u32(data + 16) == 0) return -2;
+    m->rom_crc = get_u32(data + 12);
+    m->hash_interval = get_u32(data + 16);
+    m->start_ram_size = get_u32(data + 20);
+    size_t pos = MOVIE_HEADER_SIZE;
+    if (m->start_ram_size > size - pos) return -2;
+    if (m->start_ram_size) {
+        m->start_ram = (uint8_t*)malloc(m->start_ram_size);
+        if (!m->start_ram) return -1;
+        memcpy(m->start_ram, data + pos, m->start_ram_size);
+        pos += m->start_ram_size;
+    }
+
+    // Every frame is two bytes and every interval adds a hash, so this
+    // bounds both arrays
+    uint64_t max_frames = (size - pos) / 2;
+    m->pads = (uint8_t*)malloc(max_frames ? max_frames * 2 : 1);
+    m->hashes = (uint64_t*)malloc((max_frames / m->hash_interval + 1) * sizeof(uint64_t));
+    if (!m->pads || !m->hashes) return -1;
+    while (size - pos >= 2) {
+        bool hash_due = (m->frame_count + 1) % m->hash_interval == 0;
+        if (hash_due && size - pos < 10) break; // cut short while writing
+        m->pads[m->frame_count * 2] = data[pos];
+        m->pads[m->frame_count * 2 + 1] = data[pos + 1];
+        pos += 2;
+        ++m->frame_count;
+        if (hash_due) {
+            m->hashes[m->hash_count++] = get_u64(data + pos);
+            pos += 8;
+        }
+    }
+    return 0;
+}
+
+// Whole file into memory; false if it cannot be read
+static bool read_file(const char *path, uint8_t **data_out, size_t *size_out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t *data = NULL;
+    size_t size = 0, cap = 0;
+    bool ok = true;
+    while (ok) {
+        if (size == cap) {
+            cap = cap ? cap * 2 : 1 << 16;
+            uint8_t *grown = (uint8_t*)realloc(data, cap);
+            if (!grown) { ok = false; break; }
+            data = grown;
+        }
+        size_t n = fread(data + size, 1, cap - size, f);
+        if (n == 0) { ok = !ferror(f); break; }
+        size += n;
+    }
+    fclose(f);
+    if (!ok) { free(data); return false; }
+    *data_out = data;
+    *size_out = size;
+    return true;
+}
+
+int movie_load(Movie *m, const char *path) {
+    memset(m, 0, sizeof(*m));
+    uint8_t *data;
+    size_t size;
+    if (!read_file(path, &data, &size)) return -1;
+    int rc = movie_parse(m, data, size);
+    free(data);
+    if (rc != 0) movie_close(m);
+    return rc;
+}
+
+bool movie_play_start(Movie *m, NES *nes) {
+    Cartridge *c = &nes->cart;
+    if (c->crc32 != m->rom_crc) return false;
+    if (m->start_ram_size != (c->prg_ram ? c->prg_ram_size : 0)) return false;
+    if (c->prg_ram) {
+        if (!cart_detach_save(c)) return false;
+        memcpy(c->prg_ram, m->start_ram, m->start_ram_size);
+        bus_map_cart(&nes->bus);
+    }
+    m->frame = 0;
+    return true;
+}
+
+// Keyframe for the start of the coming frame
+static void movie_write_key(Movie *m, const NES *nes) {
+    uint8_t head[KEYS_RECORD_HEADER];
+    put_u64(head, m->frame);
+    put_u64(head + 8, nes_state_hash(nes));
+    bool ok = nes_save_state(nes, m->key_state, m->key_state_size) == m->key_state_size &&
+              fwrite(head, sizeof(head), 1, m->keys) == 1 &&
+              fwrite(m->key_state, m->key_state_size, 1, m->keys) == 1;
+    if (!ok) {
+        m->keys_failed = true;
+        fclose(m->keys);
+        m->keys = NULL;
+    }
+}
+
+bool movie_begin_frame(Movie *m, NES *nes) {
+    if (m->keys && m->frame % m->key_interval == 0) movie_write_key(m, nes);
+    if (m->out) {
+        uint8_t pads[2] = { nes->ctrl1.state, nes->ctrl2.state };
+        return fwrite(pads, sizeof(pads), 1, m->out) == 1;
+    }
+    if (m->frame >= m->frame_count) return false;
+    controller_set_state(&nes->ctrl1, m->pads[m->frame * 2]);
+    controller_set_state(&nes->ctrl2, m->pads[m->frame * 2 + 1]);
+    return true;
+}
+
+bool movie_end_frame(Movie *m, const NES *nes) {
+    ++m->frame;
+    if (m->frame % m->hash_interval != 0) return true;
+    uint64_t hash = nes_state_hash(nes);
+    if (m->out) {
+        uint8_t bytes[8];
+        put_u64(bytes, hash);
+        return fwrite(bytes, sizeof(bytes), 1, m->out) == 1;
+    }
+    uint64_t i = m->frame / m->hash_interval - 1;
+    if (i >= m->hash_count) return true;
+    ++m->hashes_checked;
+    if (hash == m->hashes[i]) return true;
+    m->diverged = true;
+    m->diverged_frame = m->frame;
+    m->got_hash = hash;
+    m->want_hash = m->hashes[i];
+    return false;
+}
+
+bool movie_keys_start(Movie *m, const char *path, const NES *nes, uint32_t interval) {
+    m->key_interval = interval ? interval : 1;
+    m->key_state_size = nes_state_size(nes);
+    m->key_state = (uint8_t*)malloc(m->key_state_size);
+    m->keys = m->key_state ? fopen(path, "wb") : NULL;
+    if (!m->keys) return false;
+    uint8_t header[KEYS_HEADER_SIZE];
+    memcpy(header, KEYS_MAGIC, sizeof(KEYS_MAGIC));
+    put_u32(header + 8, KEYS_VERSION);
+    put_u32(header + 12, nes->cart.crc32);
+    put_u32(header + 16, m->key_interval);
+    put_u32(header + 20, (uint32_t)m->key_state_size);
+    if (fwrite(header, sizeof(header), 1, m->keys) != 1) {
+        fclose(m->keys);
+        m->keys = NULL;
+        return false;
+    }
+    return true;
+}
+
+int movie_keys_load(MovieKeys *k, const char *path) {
+    memset(k, 0, sizeof(*k));
+    uint8_t *data;
+    size_t size;
+    if (!read_file(path, &data, &size)) return -1;
+    if (size < KEYS_HEADER_SIZE || memcmp(data, KEYS_MAGIC, sizeof(KEYS_MAGIC)) != 0 ||
+        get_u32(data + 8) != KEYS_VERSION || get_u32(data + 20) == 0) {
+        free(data);
+        return -2;
+    }
+    k->rom_crc = get_u32(data + 12);
+    k->interval = get_u32(data + 16);
+    k->state_size = get_u32(data + 20);
+    // A keyframe cut short while writing is dropped
+    size_t record = KEYS_RECORD_HEADER + k->state_size;
+    size_t count = (size - KEYS_HEADER_SIZE) / record;
+    k->frames = (uint64_t*)malloc((count ? count : 1) * sizeof(uint64_t));
+    k->hashes = (uint64_t*)malloc((count ? count : 1) * sizeof(uint64_t));
+    k->states = (uint8_t*)malloc(count ? count * k->state_size : 1);
+    if (!k->frames || !k->hashes || !k->states) {
+        free(data);
+        movie_keys_free(k);
+        return -1;
+    }
+    const uint8_t *in = data + KEYS_HEADER_SIZE;
+    for (size_t i = 0; i < count; ++i, in += record) {
+        k->frames[i] = get_u64(in);
+        k->hashes[i] = get_u64(in + 8);
+        memcpy(k->states + i * k->state_size, in + KEYS_RECORD_HEADER, k->state_size);
+    }
+    k->count = count;
+    free(data);
+    return 0;
+}
+
+void movie_keys_free(MovieKeys *k) {
+    free(k->frames);
+    free(k->hashes);
+    free(k->states);
+    memset(k, 0, sizeof(*k));
+}
+
+// CPU time of the calling thread, so a segment's timing does not include
+// waiting for a core
+static double thread_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    const Movie *movie;
+    const MovieKeys *keys;
+    const NES *base;
+    MovieSegment *out;
+    atomic_bool clone_failed;
+} VerifyJob;
+
+static void segment_fail(MovieSegment *s, uint64_t frame, uint64_t got, uint64_t want) {
+    s->pass = false;
+    s->diverged_frame = frame;
+    s->got_hash = got;
+    s->want_hash = want;
+}
+
+// Replay segment i from its keyframe, checking every hash due along the way
+static void verify_segment(void *ctx, size_t i) {
+    VerifyJob *job = (VerifyJob*)ctx;
+    const Movie *m = job->movie;
+    const MovieKeys *k = job->keys;
+    MovieSegment *s = &job->out[i];
+    double t0 = thread_sec();
+    s->first_frame = k->frames[i];
+    s->end_frame = i + 1 < k->count ? k->frames[i + 1] : m->frame_count;
+    NES nes;
+    if (!nes_clone(job->base, &nes)) {
+        atomic_store(&job->clone_failed, true);
+        return;
+    }
+    // The first segment replays from power-on itself rather than trusting
+    // its keyframe; the keyframe's hash must then match the clone's
+    s->pass = i == 0 || nes_load_state(&nes, k->states + i * k->state_size, k->state_size);
+    s->bad_state = !s->pass;
+    // The keyframe's own hash shows whether this build hashes it the same way
+    uint64_t hash = s->pass ? nes_state_hash(&nes) : 0;
+    if (s->pass && hash != k->hashes[i]) segment_fail(s, s->first_frame, hash, k->hashes[i]);
+    for (uint64_t f = s->first_frame; s->pass && f < s->end_frame;) {
+        controller_set_state(&nes.ctrl1, m->pads[f * 2]);
+        controller_set_state(&nes.ctrl2, m->pads[f * 2 + 1]);
+        nes_run_frame(&nes);
+        ++f;
+        bool movie_check = f % m->hash_interval == 0 && f / m->hash_interval <= m->hash_count;
+        bool key_check = f == s->end_frame && i + 1 < k->count;
+        if (!movie_check && !key_check) continue;
+        hash = nes_state_hash(&nes);
+        uint64_t want = movie_check ? m->hashes[f / m->hash_interval - 1] : k->hashes[i + 1];
+        if (hash != want) segment_fail(s, f, hash, want);
+        else if (key_check && hash != k->hashes[i + 1]) segment_fail(s, f, hash, k->hashes[i + 1]);
+    }
+    nes_free(&nes);
+    s->seconds = thread_sec() - t0;
+}
+
+bool movie_verify_segments(const Movie *m, const MovieKeys *keys, const NES *base, ThreadPool *pool,
+                           MovieSegment *out) {
+    // Segments must cover the movie from power-on
+    if (keys->rom_crc != m->rom_crc || keys->state_size != nes_state_size(base) || keys->count == 0 ||
+        keys->frames[0] != 0) return false;
+    for (size_t i = 0; i < keys->count; ++i) {
+        if (keys->frames[i] > m->frame_count || (i > 0 && keys->frames[i] <= keys->frames[i - 1])) return false;
+    }
+    VerifyJob job = { .movie = m, .keys = keys, .base = base, .out = out };
+    atomic_init(&job.clone_failed, false);
+    memset(out, 0, keys->count * sizeof(MovieSegment));
+    threadpool_run(pool, keys->count, verify_segment, &job);
+    return !atomic_load(&job.clone_failed);
+}
+
+bool movie_close(Movie *m) {
+    bool ok = true;
+    if (m->out) ok = fclose(m->out) == 0;
+    if (m->keys && fclose(m->keys) != 0) m->keys_failed = true;
+    ok = ok && !m->keys_failed;
+    free(m->key_state);
+    m->keys = NULL;
+    m->key_state = NULL;
+    free(m->start_ram);
+    free(m->pads);
+    free(m->hashes);
+    m->out = NULL;
+    m->start_ram = NULL;
+    m->pads = NULL;
+    m->hashes = NULL;
+    return ok;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "nes.h"
+#include "threadpool.h"
+
+// Input movies: the pad states of both controllers for every frame from
+// reset, plus nes_state_hash every hash_interval frames, so playback can be
+// checked for bit-exact agreement with the recording.
+//
+// File (little-endian): "NESMOVIE", u32 version, u32 ROM CRC32, u32
+// hash_interval, u32 PRG RAM size and the PRG RAM contents at the start (a
+// battery save changes how a game boots). Then per frame: pad1, pad2, and
+// after every hash_interval-th frame the u64 hash. A partial last interval
+// is played but not checked.
+typedef struct {
+    FILE *out;              // recording
+    uint32_t hash_interval;
+    uint64_t frame;         // frames recorded or played so far
+
+    // Playback: the whole movie, decoded
+    uint32_t rom_crc;
+    uint8_t *start_ram;     // PRG RAM at the start
+    uint32_t start_ram_size;
+    uint8_t *pads;          // pad1, pad2 per frame
+    uint64_t frame_count;
+    uint64_t *hashes;       // hashes[i]: after frame (i + 1) * hash_interval
+    uint64_t hash_count;
+    uint64_t hashes_checked;
+
+    // First failed check
+    bool diverged;
+    uint64_t diverged_frame;
+    uint64_t got_hash, want_hash;
+
+    // Keyframe file being written alongside (recording or playback)
+    FILE *keys;
+    uint32_t key_interval;
+    uint8_t *key_state;
+    size_t key_state_size;
+    bool keys_failed;
+} Movie;
+
+// Keyframes: save states along a movie, so stretches of it can be replayed
+// independently. File (little-endian): "NESKEYS\0", u32 version, u32 ROM
+// CRC32, u32 interval, u32 state size, then per keyframe: u64 frame (the
+// state at the start of that frame), u64 nes_state_hash, the state. Save
+// states are build-specific (see nes.h): make keyframes with a trusted build
+// by playing the movie once, and verify with builds that keep its state
+// layout.
+typedef struct {
+    uint32_t rom_crc;
+    uint32_t interval;
+    size_t state_size;
+    size_t count;
+    uint64_t *frames;
+    uint64_t *hashes;
+    uint8_t *states;    // count * state_size
+} MovieKeys;
+
+// One stretch between keyframes and how its replay went
+typedef struct {
+    uint64_t first_frame, end_frame;
+    bool pass;
+    bool bad_state;         // the keyframe would not load
+    uint64_t diverged_frame; // first failed check when !pass
+    uint64_t got_hash, want_hash;
+    double seconds;          // CPU time of the replay
+} MovieSegment;
+
+// Start recording a freshly reset NES (before its first frame)
+bool movie_record_start(Movie *m, const char *path, const NES *nes, uint32_t hash_interval);
+// Read a movie for playback: 0 on success, -1 if the file cannot be read,
+// -2 if it is not a movie or is damaged. A recording cut short mid-frame
+// loses only that frame.
+int movie_load(Movie *m, const char *path);
+// Put a freshly reset NES at the movie's starting point: PRG RAM gets the
+// recorded contents, and a .sav mapping is detached first so playback never
+// writes the user's save. False if the ROM or its RAM size does not match.
+bool movie_play_start(Movie *m, NES *nes);
+// Before each frame: write the current pads, or set them from the movie.
+// False at the end of the movie or on a write error.
+bool movie_begin_frame(Movie *m, NES *nes);
+// After each frame: write or check the hash when one is due. False on a
+// write error or when playback diverges (diverged is then set).
+bool movie_end_frame(Movie *m, const NES *nes);
+// Also write a keyframe every interval frames, starting before the first
+// frame. Call after movie_record_start or movie_play_start.
+bool movie_keys_start(Movie *m, const char *path, const NES *nes, uint32_t interval);
+// 0 on success, -1 if the file cannot be read, -2 if it is not a keyframe
+// file or is damaged
+int movie_keys_load(MovieKeys *k, const char *path);
+void movie_keys_free(MovieKeys *k);
+
+// Replay every keyframe-to-keyframe segment of a loaded movie on the pool.
+// Each segment starts from a clone of base (the ROM loaded, reset and put
+// through movie_play_start) with its keyframe loaded, checks the movie's
+// hashes inside it and must end on the next keyframe's hash; the last one
+// runs to the end of the movie. The first keyframe must be at frame 0; that
+// segment replays from base itself, so every frame is covered from power-on.
+// out needs keys->count entries. False if the keyframes do not belong to
+// this movie or do not start at frame 0, or a clone cannot be made.
+bool movie_verify_segments(const Movie *m, const MovieKeys *keys, const NES *base, ThreadPool *pool,
+                           MovieSegment *out);
+
+// Finish a recording (false if anything failed to reach the file) and free
+// the movie
+bool movie_close(Movie *m);
@@ -1,32 +1,86 @@
 #include "nes.h"
+#include <stddef.h>
 #include <string.h>
 
-void nes_init(NES *nes, bool enable_audio) {
+// CPU cycles a DMC sample fetch steals: 4 in general, 3 when the halt lands
+// on a write cycle. The CPU core is instruction-granular, so always 4. A
+// fetch inside an OAM DMA rides on the already-halted CPU and costs 2.
+#define DMC_DMA_STALL_CYCLES 4
+#define DMC_DMA_OAM_STALL_CYCLES 2
+
+void nes_init(NES *nes) {
     memset(nes, 0, sizeof(*nes));
     controller_reset(&nes->ctrl1);
     controller_reset(&nes->ctrl2);
     bus_init(&nes->bus, nes);
     ppu_power_on(&nes->ppu);
+    ppu_alloc_framebuffer(&nes->ppu);
     // Important: power on CPU before connecting the bus; cpu_power_on zeroes the struct
     cpu_power_on(&nes->cpu);
     cpu_connect_bus(&nes->cpu, &nes->bus);
-    // Try to init audio (optional)
-    if (enable_audio) {
-        apu_init(&nes->apu);
-        if (nes->apu) apu_connect_bus(nes->apu, &nes->bus);
-    } else {
-        nes->apu = NULL;
+    apu_init(&nes->apu);
+    nes_sync_apu(nes);
+}
+
+void nes_sync_apu(NES *nes) {
+    if (!nes->apu) { nes->apu_deadline = UINT64_MAX; nes->apu_irq = false; return; }
+    uint64_t due = nes->apu_deadline; // when a pending DMA was requested
+    apu_run_until(nes->apu, nes->cpu.cycles);
+    uint16_t addr;
+    if (apu_dmc_dma_pending(nes->apu, &addr)) {
+        // The DMA unit halts the CPU and reads the sample byte through the
+        // bus page table (samples live in PRG ROM/RAM). The stall lands at
+        // the next instruction boundary.
+        apu_dmc_dma_complete(nes->apu, bus_cpu_read(&nes->bus, addr));
+        bool in_oam_dma = due >= nes->oam_dma_start && due < nes->oam_dma_end;
+        nes->cpu.stall_cycles += in_oam_dma ? DMC_DMA_OAM_STALL_CYCLES : DMC_DMA_STALL_CYCLES;
     }
+    nes->apu_irq = apu_frame_irq_pending(nes->apu) || apu_dmc_irq_pending(nes->apu);
+    nes->apu_deadline = apu_next_event_cycle(nes->apu);
 }
 
-int nes_load_rom(NES *nes, const char *path) {
-    int rc = cartridge_load(path, &nes->cart);
+void nes_free(NES *nes) {
+    apu_shutdown(&nes->apu);
+    cartridge_free(&nes->cart);
+    ppu_free(&nes->ppu);
+}
+
+bool nes_clone(const NES *src, NES *dst) {
+    // Plain copy of the registers and memories, then re-point everything
+    // that referred to src
+    *dst = *src;
+    dst->ppu.framebuffer = NULL;
+    dst->ppu.bg_opaque = NULL;
+    dst->apu = NULL;
+    if (!cart_clone(&src->cart, &dst->cart)) { dst->cart = (Cartridge){0}; return false; }
+    if (src->apu && !apu_clone(src->apu, &dst->apu)) { cartridge_free(&dst->cart); return false; }
+    dst->cpu.bus = &dst->bus;
+    dst->ppu.cart = src->ppu.cart ? &dst->cart : NULL;
+    bus_connect(&dst->bus, dst);
+    bus_map_cart(&dst->bus);
+    return true;
+}
+
+const uint32_t *nes_framebuffer(NES *nes) {
+    return ppu_alloc_framebuffer(&nes->ppu) ? nes->ppu.framebuffer : NULL;
+}
+
+static int nes_attach_cart(NES *nes, int rc) {
     if (rc == 0) {
         ppu_connect_cartridge(&nes->ppu, &nes->cart, nes->cart.mirror);
+        bus_map_cart(&nes->bus);
     }
     return rc;
 }
 
+int nes_load_rom(NES *nes, const char *path) {
+    return nes_attach_cart(nes, cartridge_load(path, &nes->cart));
+}
+
+int nes_load_rom_mem(NES *nes, const void *data, size_t size) {
+    return nes_attach_cart(nes, cartridge_load_mem(data, size, &nes->cart));
+}
+
 void nes_reset(NES *nes) {
     // Reset CPU which also reads reset vector from PRG ROM via bus
     cpu_reset(&nes->cpu);
@@ -37,25 +91,40 @@ void nes_reset(NES *nes) {
     }
 }
 
+// One CPU instruction plus the PPU time it covers. The APU runs lazily: only
+// when its IRQ deadline passes or its registers are touched.
+static int nes_step(NES *nes) {
+    int used = cpu_step(&nes->cpu);
+    if (used <= 0) used = 1; // safety
+    // Tick PPU based on CPU cycles consumed
+    ppu_tick_cpu_cycles(&nes->ppu, used);
+    if (nes->ppu.nmi_pending) {
+        nes->ppu.nmi_pending = false;
+        nes->cpu.nmi_line = true;
+    }
+    if (nes->cpu.cycles >= nes->apu_deadline) nes_sync_apu(nes);
+    // IRQ is level-triggered: it stays asserted until a source is
+    // acknowledged. APU and mapper share the line.
+    nes->cpu.irq_line = nes->apu_irq || nes->cart.irq;
+    return used;
+}
+
 void nes_run_cycles(NES *nes, int cycles) {
     int remaining = cycles;
     while (remaining > 0) {
-        int used = cpu_step(&nes->cpu);
-        if (used <= 0) used = 1; // safety
-        // Tick PPU based on CPU cycles consumed
-        ppu_tick_cpu_cycles(&nes->ppu, used);
-        if (nes->ppu.nmi_pending) {
-            nes->ppu.nmi_pending = false;
-            nes->cpu.nmi_line = true;
-        }
-        if (nes->apu) {
-            apu_tick_cpu_cycles(nes->apu, used);
-            if (apu_frame_irq_pending(nes->apu) || apu_dmc_irq_pending(nes->apu)) {
-                nes->cpu.irq_line = true;
-            }
-        }
-        remaining -= used;
+        remaining -= nes_step(nes);
     }
+    nes_sync_apu(nes);
+}
+
+int nes_run_frame(NES *nes) {
+    int cycles = 0;
+    nes->ppu.frame_ready = false;
+    while (!nes->ppu.frame_ready) {
+        cycles += nes_step(nes);
+    }
+    nes_sync_apu(nes);
+    return cycles;
 }
 
 int nes_step_instruction(NES *nes) {
@@ -65,3 +134,185 @@ int nes_step_instruction(NES *nes) {
     if (nes->ppu.nmi_pending) { nes->ppu.nmi_pending = false; nes->cpu.nmi_line = true; }
     return used;
 }
+
+// Save state layout: 8-byte magic, u32 version, then chunks of u32 tag, u32
+// payload size and the payload, all host byte order. Unknown tags are
+// skipped so later versions can add chunks.
+static const char NES_STATE_MAGIC[8] = { 'N','E','S','S','T','A','T','E' };
+#define NES_STATE_VERSION 1
+#define NES_STATE_HEADER_SIZE 12
+#define NES_STATE_CHUNK_HEADER 8
+
+#define STATE_TAG(a, b, c, d) ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+enum {
+    CHUNK_CPU, CHUNK_RAM, CHUNK_PPU, CHUNK_APU, CHUNK_CTRL, CHUNK_SYS, CHUNK_CART, CHUNK_PRAM, CHUNK_CRAM,
+    CHUNK_COUNT
+};
+static const uint32_t STATE_TAGS[CHUNK_COUNT] = {
+    [CHUNK_CPU] = STATE_TAG('C','P','U',' '), [CHUNK_RAM] = STATE_TAG('R','A','M',' '),
+    [CHUNK_PPU] = STATE_TAG('P','P','U',' '), [CHUNK_APU] = STATE_TAG('A','P','U',' '),
+    [CHUNK_CTRL] = STATE_TAG('C','T','R','L'), [CHUNK_SYS] = STATE_TAG('S','Y','S',' '),
+    [CHUNK_CART] = STATE_TAG('C','A','R','T'), [CHUNK_PRAM] = STATE_TAG('P','R','A','M'),
+    [CHUNK_CRAM] = STATE_TAG('C','R','A','M'),
+};
+
+// CPU: registers, interrupt lines, cycle count and stall; not the bus link
+#define CPU_STATE_HEAD offsetof(CPU, bus)
+#define CPU_STATE_TAIL_BEGIN offsetof(CPU, nmi_line)
+#define CPU_STATE_SIZE (CPU_STATE_HEAD + sizeof(CPU) - CPU_STATE_TAIL_BEGIN)
+// SYS: scheduler bookkeeping that is not derived from the APU
+#define SYS_STATE_SIZE (2 * sizeof(uint64_t))
+
+// Expected payload size of each chunk for this NES (0: chunk absent)
+static void nes_chunk_sizes(const NES *nes, size_t sizes[CHUNK_COUNT]) {
+    sizes[CHUNK_CPU] = CPU_STATE_SIZE;
+    sizes[CHUNK_RAM] = sizeof(nes->bus.ram);
+    sizes[CHUNK_PPU] = ppu_state_size();
+    sizes[CHUNK_APU] = nes->apu ? apu_state_size() : 0;
+    sizes[CHUNK_CTRL] = 2 * sizeof(Controller);
+    sizes[CHUNK_SYS] = SYS_STATE_SIZE;
+    sizes[CHUNK_CART] = cart_state_size(&nes->cart);
+    sizes[CHUNK_PRAM] = nes->cart.prg_ram ? nes->cart.prg_ram_size : 0;
+    sizes[CHUNK_CRAM] = nes->cart.chr_is_ram ? nes->cart.chr_size : 0;
+}
+
+size_t nes_state_size(const NES *nes) {
+    size_t sizes[CHUNK_COUNT];
+    nes_chunk_sizes(nes, sizes);
+    size_t total = NES_STATE_HEADER_SIZE;
+    for (int i = 0; i < CHUNK_COUNT; ++i) {
+        if (sizes[i]) total += NES_STATE_CHUNK_HEADER + sizes[i];
+    }
+    return total;
+}
+
+static uint8_t *state_put_u32(uint8_t *out, uint32_t v) {
+    memcpy(out, &v, sizeof(v));
+    return out + sizeof(v);
+}
+
+size_t nes_save_state(const NES *nes, void *buf, size_t cap) {
+    size_t sizes[CHUNK_COUNT];
+    nes_chunk_sizes(nes, sizes);
+    if (cap < nes_state_size(nes)) return 0;
+    uint8_t *out = (uint8_t*)buf;
+    memcpy(out, NES_STATE_MAGIC, sizeof(NES_STATE_MAGIC));
+    out = state_put_u32(out + sizeof(NES_STATE_MAGIC), NES_STATE_VERSION);
+    for (int i = 0; i < CHUNK_COUNT; ++i) {
+        if (!sizes[i]) continue;
+        out = state_put_u32(out, STATE_TAGS[i]);
+        out = state_put_u32(out, (uint32_t)sizes[i]);
+        switch (i) {
+            case CHUNK_CPU:
+                memcpy(out, &nes->cpu, CPU_STATE_HEAD);
+                memcpy(out + CPU_STATE_HEAD, (const uint8_t*)&nes->cpu + CPU_STATE_TAIL_BEGIN, sizeof(CPU) - CPU_STATE_TAIL_BEGIN);
+                break;
+            case CHUNK_RAM: memcpy(out, nes->bus.ram, sizes[i]); break;
+            case CHUNK_PPU: ppu_save_state(&nes->ppu, out); break;
+            case CHUNK_APU: apu_save_state(nes->apu, out); break;
+            case CHUNK_CTRL:
+                memcpy(out, &nes->ctrl1, sizeof(Controller));
+                memcpy(out + sizeof(Controller), &nes->ctrl2, sizeof(Controller));
+                break;
+            case CHUNK_SYS:
+                memcpy(out, &nes->oam_dma_start, sizeof(uint64_t));
+                memcpy(out + sizeof(uint64_t), &nes->oam_dma_end, sizeof(uint64_t));
+                break;
+            case CHUNK_CART: cart_save_state(&nes->cart, out); break;
+            case CHUNK_PRAM: memcpy(out, nes->cart.prg_ram, sizes[i]); break;
+            case CHUNK_CRAM: memcpy(out, nes->cart.chr, sizes[i]); break;
+        }
+        out += sizes[i];
+    }
+    return (size_t)(out - (uint8_t*)buf);
+}
+
+bool nes_load_state(NES *nes, const void *buf, size_t len) {
+    const uint8_t *in = (const uint8_t*)buf;
+    uint32_t version, tag, size;
+    if (len < NES_STATE_HEADER_SIZE || memcmp(in, NES_STATE_MAGIC, sizeof(NES_STATE_MAGIC)) != 0) return false;
+    memcpy(&version, in + sizeof(NES_STATE_MAGIC), sizeof(version));
+    if (version != NES_STATE_VERSION) return false;
+
+    // Find and size-check every chunk before touching anything
+    size_t sizes[CHUNK_COUNT];
+    const uint8_t *chunk[CHUNK_COUNT] = { 0 };
+    nes_chunk_sizes(nes, sizes);
+    size_t pos = NES_STATE_HEADER_SIZE;
+    while (len - pos >= NES_STATE_CHUNK_HEADER) {
+        memcpy(&tag, in + pos, sizeof(tag));
+        memcpy(&size, in + pos + 4, sizeof(size));
+        pos += NES_STATE_CHUNK_HEADER;
+        if (size > len - pos) return false;
+        for (int i = 0; i < CHUNK_COUNT; ++i) {
+            if (tag != STATE_TAGS[i]) continue;
+            if (size != sizes[i] || chunk[i]) return false;
+            chunk[i] = in + pos;
+        }
+        pos += size;
+    }
+    for (int i = 0; i < CHUNK_COUNT; ++i) {
+        if (sizes[i] && !chunk[i]) return false;
+    }
+
+    memcpy(&nes->cpu, chunk[CHUNK_CPU], CPU_STATE_HEAD);
+    memcpy((uint8_t*)&nes->cpu + CPU_STATE_TAIL_BEGIN, chunk[CHUNK_CPU] + CPU_STATE_HEAD, sizeof(CPU) - CPU_STATE_TAIL_BEGIN);
+    memcpy(nes->bus.ram, chunk[CHUNK_RAM], sizes[CHUNK_RAM]);
+    ppu_load_state(&nes->ppu, chunk[CHUNK_PPU], sizes[CHUNK_PPU]);
+    if (nes->apu) apu_load_state(nes->apu, chunk[CHUNK_APU], sizes[CHUNK_APU]);
+    memcpy(&nes->ctrl1, chunk[CHUNK_CTRL], sizeof(Controller));
+    memcpy(&nes->ctrl2, chunk[CHUNK_CTRL] + sizeof(Controller), sizeof(Controller));
+    memcpy(&nes->oam_dma_start, chunk[CHUNK_SYS], sizeof(uint64_t));
+    memcpy(&nes->oam_dma_end, chunk[CHUNK_SYS] + sizeof(uint64_t), sizeof(uint64_t));
+    cart_load_state(&nes->cart, chunk[CHUNK_CART], sizes[CHUNK_CART]);
+    // Only touch a .sav mapping when the contents really change
+    if (chunk[CHUNK_PRAM] && memcmp(nes->cart.prg_ram, chunk[CHUNK_PRAM], sizes[CHUNK_PRAM]) != 0) {
+        memcpy(nes->cart.prg_ram, chunk[CHUNK_PRAM], sizes[CHUNK_PRAM]);
+        nes->cart.sav_dirty = ~0ull; // whole .sav, flushed as usual
+    }
+    if (chunk[CHUNK_CRAM]) memcpy(nes->cart.chr, chunk[CHUNK_CRAM], sizes[CHUNK_CRAM]);
+
+    // Mapper banks moved and the APU jumped: rebuild the page table and
+    // re-derive the scheduler's view of the APU (as of its last catch-up)
+    bus_map_cart(&nes->bus);
+    nes->apu_irq = apu_frame_irq_pending(nes->apu) || apu_dmc_irq_pending(nes->apu);
+    nes->apu_deadline = apu_next_event_cycle(nes->apu);
+    return true;
+}
+
+// FNV-1a, 64-bit
+#define HASH_OFFSET 0xcbf29ce484222325ull
+#define HASH_PRIME 0x100000001b3ull
+
+static uint64_t hash_bytes(uint64_t h, const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * HASH_PRIME;
+    return h;
+}
+
+// Values go in as little-endian bytes, so the hash does not depend on
+// struct layout or host byte order
+static uint64_t hash_value(uint64_t h, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) h = (h ^ (uint8_t)(v >> (8 * i))) * HASH_PRIME;
+    return h;
+}
+
+uint64_t nes_state_hash(const NES *nes) {
+    const CPU *c = &nes->cpu;
+    const PPU *p = &nes->ppu;
+    uint64_t h = HASH_OFFSET;
+    h = hash_value(h, c->A, 1); h = hash_value(h, c->X, 1); h = hash_value(h, c->Y, 1);
+    h = hash_value(h, c->S, 1); h = hash_value(h, c->P, 1); h = hash_value(h, c->PC, 2);
+    h = hash_value(h, c->cycles, 8);
+    h = hash_bytes(h, nes->bus.ram, sizeof(nes->bus.ram));
+    h = hash_value(h, p->ppuctrl, 1); h = hash_value(h, p->ppumask, 1);
+    h = hash_value(h, p->ppustatus, 1); h = hash_value(h, p->oamaddr, 1);
+    h = hash_value(h, p->v, 2); h = hash_value(h, p->t, 2);
+    h = hash_value(h, p->x_fine, 1); h = hash_value(h, p->w, 1);
+    h = hash_value(h, (uint64_t)p->scanline, 2); h = hash_value(h, (uint64_t)p->dot, 2);
+    h = hash_bytes(h, p->vram, sizeof(p->vram));
+    h = hash_bytes(h, p->palette, sizeof(p->palette));
+    h = hash_bytes(h, p->oam, sizeof(p->oam));
+    if (nes->cart.prg_ram) h = hash_bytes(h, nes->cart.prg_ram, nes->cart.prg_ram_size);
+    if (nes->cart.chr_is_ram) h = hash_bytes(h, nes->cart.chr, nes->cart.chr_size);
+    return h;
+}
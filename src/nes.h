@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "cpu.h"
@@ -15,14 +16,55 @@ typedef struct NES {
     Cartridge cart;
     Controller ctrl1, ctrl2;
     APU *apu;
+    uint64_t apu_deadline; // CPU cycle at which the APU must next be caught up
+    bool apu_irq;          // APU IRQ flags as of the last catch-up
+    uint64_t oam_dma_start, oam_dma_end; // CPU cycles of the last OAM DMA halt
 
     bool running;
 } NES;
 
 int nes_load_rom(NES *nes, const char *path);
-void nes_init(NES *nes, bool enable_audio);
+// From a .nes image in memory (copied; battery RAM is not persisted)
+int nes_load_rom_mem(NES *nes, const void *data, size_t size);
+// The APU core is always created; attach an AudioSink to hear it
+void nes_init(NES *nes);
+// Release the APU, cartridge and framebuffer
+void nes_free(NES *nes);
+// Fork a running NES into dst (uninitialized memory). Only mutable state is
+// copied: CPU/PPU registers, RAM, VRAM, OAM, palette, APU timing, mapper
+// registers and cartridge RAM (~15KB with 8KB PRG RAM). The ROM image is
+// shared by reference. The clone has no audio sink and no framebuffer until
+// nes_framebuffer is called, so it renders nothing by default. Discard it
+// with nes_free; src may be freed first.
+bool nes_clone(const NES *src, NES *dst);
+// The framebuffer, allocated on first use (rendering starts from then on)
+const uint32_t *nes_framebuffer(NES *nes);
 void nes_reset(NES *nes);
 // Run a rough number of CPU cycles (will tick PPU alongside)
 void nes_run_cycles(NES *nes, int cycles);
+// Run until the PPU wraps to the next frame (~29780.5 CPU cycles on NTSC);
+// returns CPU cycles consumed
+int nes_run_frame(NES *nes);
+// Catch the APU up to the CPU and re-arm its deadline; call after any APU
+// register access
+void nes_sync_apu(NES *nes);
 // Run a single instruction; returns cycles consumed
 int nes_step_instruction(NES *nes);
+
+// Save states: "NESSTATE", a version, then tagged chunks (CPU, RAM, PPU,
+// APU, controllers, mapper, PRG RAM, CHR RAM) of host-layout data, so a
+// state is only valid for the ROM and build that wrote it. The framebuffer
+// is not included; it is redrawn by the next frame. Sizes are fixed per
+// ROM: nes_state_size bytes, about 5KB plus cartridge RAM.
+size_t nes_state_size(const NES *nes);
+// Returns bytes written, or 0 if cap is too small
+size_t nes_save_state(const NES *nes, void *buf, size_t cap);
+// Rejects states from another version, build or cartridge layout without
+// changing the NES. Pending audio is not rewound, only the APU registers.
+bool nes_load_state(NES *nes, const void *buf, size_t len);
+
+// 64-bit hash of the observable machine: CPU registers and cycle count, RAM,
+// PPU registers and position, VRAM, palette, OAM and cartridge RAM. Built
+// from values rather than struct bytes, so it stays comparable across
+// builds and refactors of the core (movie verification relies on this).
+uint64_t nes_state_hash(const NES *nes);
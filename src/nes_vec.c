@@ -0,0 +1,298 @@
+// pthread_setaffinity_np and CPU_SET are GNU extensions
+#define _GNU_SOURCE
+#include "nes_vec.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NES_VEC_CACHE_LINE 64
+#define NES_VEC_PAGE 4096
+// Idle worker: pause-spin, then yield, then sleep. A frame takes on the
+// order of a millisecond, so the spins cover the gap between steps of a
+// busy training loop.
+#define NES_VEC_SPINS 4096
+#define NES_VEC_YIELDS 256
+
+typedef struct {
+    // step << 32 | next offset into the block; the only field other threads write
+    _Alignas(NES_VEC_CACHE_LINE) _Atomic uint64_t cursor;
+    size_t begin, end;   // env block
+    size_t built;        // envs cloned so far
+    NES *arena;          // the block's machines, allocated by the worker
+    pthread_t thread;
+    int cpu;
+    int index;
+    NesVec *vec;
+} NesVecWorker;
+
+struct NesVec {
+    size_t count;
+    NES **envs;
+    uint32_t *obs;
+    float *rewards;
+    NesVecWorker *workers;
+    int worker_count;
+    const NES *base;     // while the workers build their blocks
+    NesVecRewardFn reward;
+    void *reward_user;
+
+    // Current step, written before it is published. step_n is atomic because
+    // a thief still finishing the previous step reads it as the next is set;
+    // it is stored only after every cursor has moved on to the new step.
+    const uint8_t *actions;
+    _Atomic size_t step_n;
+    int repeat;
+
+    _Alignas(NES_VEC_CACHE_LINE) _Atomic uint32_t step;
+    _Alignas(NES_VEC_CACHE_LINE) _Atomic size_t remaining;
+    _Atomic int ready;
+    _Atomic bool failed;
+    _Atomic bool quit;
+
+    // Slow path for idle workers
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    _Atomic int sleepers;
+};
+
+static inline void cpu_relax(void) {
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static void vec_pin(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set); // best effort
+#else
+    (void)cpu;
+#endif
+}
+
+static size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+// Clone the worker's envs into its arena and touch its observation slots,
+// all from the worker's thread
+static bool vec_build_block(NesVec *v, NesVecWorker *w) {
+    size_t n = w->end - w->begin;
+    w->arena = (NES*)aligned_alloc(NES_VEC_CACHE_LINE, round_up(n * sizeof(NES), NES_VEC_CACHE_LINE));
+    if (!w->arena) return false;
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = w->begin + k;
+        NES *e = &w->arena[k];
+        if (!nes_clone(v->base, e)) return false;
+        uint32_t *slot = v->obs + i * NES_VEC_OBS_PIXELS;
+        memset(slot, 0, NES_VEC_OBS_PIXELS * sizeof(uint32_t));
+        e->ppu.framebuffer = slot; // drawn in place; never freed through the PPU
+        v->envs[i] = e;
+        v->rewards[i] = 0.0f;
+        w->built = k + 1;
+    }
+    return true;
+}
+
+static void vec_step_env(NesVec *v, size_t i) {
+    NES *e = v->envs[i];
+    controller_set_state(&e->ctrl1, v->actions[i]);
+    float reward = 0.0f;
+    for (int f = 0; f < v->repeat; ++f) {
+        e->ppu.skip_draw = f + 1 < v->repeat;
+        nes_run_frame(e);
+        if (v->reward) reward += v->reward(v->reward_user, e, i);
+    }
+    v->rewards[i] = reward;
+    atomic_fetch_sub_explicit(&v->remaining, 1, memory_order_release);
+}
+
+// Take the next env of w's block for this step, if any is left
+static bool vec_claim(NesVec *v, NesVecWorker *w, uint32_t step, size_t *out) {
+    uint64_t c = atomic_load_explicit(&w->cursor, memory_order_acquire);
+    for (;;) {
+        if ((uint32_t)(c >> 32) != step) return false;
+        size_t i = w->begin + (uint32_t)c;
+        // Acquire: a new n implies this cursor was already reset, so the CAS fails
+        if (i >= w->end || i >= atomic_load_explicit(&v->step_n, memory_order_acquire)) return false;
+        if (atomic_compare_exchange_weak_explicit(&w->cursor, &c, c + 1, memory_order_acq_rel, memory_order_acquire)) {
+            *out = i;
+            return true;
+        }
+    }
+}
+
+// Own block first, then steal from the others in turn (self < 0: the caller)
+static void vec_work(NesVec *v, int self, uint32_t step) {
+    size_t i;
+    if (self >= 0) {
+        while (vec_claim(v, &v->workers[self], step, &i)) vec_step_env(v, i);
+    }
+    for (int k = 1; k <= v->worker_count; ++k) {
+        NesVecWorker *victim = &v->workers[(self + k + v->worker_count) % v->worker_count];
+        while (vec_claim(v, victim, step, &i)) vec_step_env(v, i);
+    }
+}
+
+// Wait for a step other than seen (or quit)
+static uint32_t vec_wait(NesVec *v, uint32_t seen) {
+    uint32_t s;
+    for (int k = 0; k < NES_VEC_SPINS + NES_VEC_YIELDS; ++k) {
+        s = atomic_load_explicit(&v->step, memory_order_acquire);
+        if (s != seen || atomic_load_explicit(&v->quit, memory_order_acquire)) return s;
+        if (k < NES_VEC_SPINS) cpu_relax();
+        else sched_yield();
+    }
+    pthread_mutex_lock(&v->lock);
+    atomic_fetch_add(&v->sleepers, 1);
+    while ((s = atomic_load(&v->step)) == seen && !atomic_load(&v->quit)) pthread_cond_wait(&v->wake, &v->lock);
+    atomic_fetch_sub(&v->sleepers, 1);
+    pthread_mutex_unlock(&v->lock);
+    return s;
+}
+
+static void vec_wake_sleepers(NesVec *v) {
+    if (atomic_load(&v->sleepers) == 0) return;
+    pthread_mutex_lock(&v->lock);
+    pthread_cond_broadcast(&v->wake);
+    pthread_mutex_unlock(&v->lock);
+}
+
+static void *vec_worker_main(void *arg) {
+    NesVecWorker *w = (NesVecWorker*)arg;
+    NesVec *v = w->vec;
+    vec_pin(w->cpu);
+    if (!vec_build_block(v, w)) atomic_store(&v->failed, true);
+    atomic_fetch_add(&v->ready, 1);
+    uint32_t seen = 0;
+    for (;;) {
+        uint32_t step = vec_wait(v, seen);
+        if (atomic_load_explicit(&v->quit, memory_order_acquire)) break;
+        seen = step;
+        vec_work(v, w->index, step);
+    }
+    return NULL;
+}
+
+NesVec *nes_vec_create(const NES *base, size_t count, int threads) {
+    if (!base || count == 0) return NULL;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0) cpus = 1;
+    if (threads <= 0) threads = (int)cpus;
+    if ((size_t)threads > count) threads = (int)count;
+
+    NesVec *v = (NesVec*)aligned_alloc(NES_VEC_CACHE_LINE, round_up(sizeof(NesVec), NES_VEC_CACHE_LINE));
+    if (!v) return NULL;
+    memset(v, 0, sizeof(*v));
+    v->count = count;
+    v->base = base;
+    pthread_mutex_init(&v->lock, NULL);
+    pthread_cond_init(&v->wake, NULL);
+    atomic_init(&v->step, 0);
+    atomic_init(&v->remaining, 0);
+    atomic_init(&v->step_n, 0);
+    atomic_init(&v->ready, 0);
+    atomic_init(&v->failed, false);
+    atomic_init(&v->quit, false);
+    atomic_init(&v->sleepers, 0);
+    // Observation pages stay untouched until their worker writes them
+    v->obs = (uint32_t*)aligned_alloc(NES_VEC_PAGE, round_up(count * NES_VEC_OBS_PIXELS * sizeof(uint32_t), NES_VEC_PAGE));
+    v->rewards = (float*)calloc(count, sizeof(float));
+    v->envs = (NES**)calloc(count, sizeof(NES*));
+    size_t workers_size = round_up((size_t)threads * sizeof(NesVecWorker), NES_VEC_CACHE_LINE);
+    v->workers = (NesVecWorker*)aligned_alloc(NES_VEC_CACHE_LINE, workers_size);
+    if (!v->obs || !v->rewards || !v->envs || !v->workers) { nes_vec_destroy(v); return NULL; }
+    memset(v->workers, 0, workers_size);
+
+    for (int t = 0; t < threads; ++t) {
+        NesVecWorker *w = &v->workers[t];
+        w->begin = count * (size_t)t / (size_t)threads;
+        w->end = count * (size_t)(t + 1) / (size_t)threads;
+        w->cpu = (int)(t % cpus);
+        w->index = t;
+        w->vec = v;
+        atomic_init(&w->cursor, 0);
+        if (pthread_create(&w->thread, NULL, vec_worker_main, w) != 0) break;
+        ++v->worker_count;
+    }
+    while (atomic_load(&v->ready) < v->worker_count) sched_yield();
+    v->base = NULL;
+    if (v->worker_count < threads || atomic_load(&v->failed)) { nes_vec_destroy(v); return NULL; }
+    return v;
+}
+
+void nes_vec_destroy(NesVec *v) {
+    if (!v) return;
+    atomic_store(&v->quit, true);
+    pthread_mutex_lock(&v->lock);
+    pthread_cond_broadcast(&v->wake);
+    pthread_mutex_unlock(&v->lock);
+    for (int t = 0; t < v->worker_count; ++t) {
+        NesVecWorker *w = &v->workers[t];
+        pthread_join(w->thread, NULL);
+        for (size_t k = 0; k < w->built; ++k) {
+            w->arena[k].ppu.framebuffer = NULL; // part of obs
+            nes_free(&w->arena[k]);
+        }
+        free(w->arena);
+    }
+    pthread_cond_destroy(&v->wake);
+    pthread_mutex_destroy(&v->lock);
+    free(v->workers);
+    free(v->envs);
+    free(v->rewards);
+    free(v->obs);
+    free(v);
+}
+
+size_t nes_vec_count(const NesVec *v) {
+    return v ? v->count : 0;
+}
+
+void nes_vec_set_reward(NesVec *v, NesVecRewardFn fn, void *user) {
+    v->reward = fn;
+    v->reward_user = user;
+}
+
+void nes_vec_step(NesVec *v, size_t n, const uint8_t *actions, int repeat) {
+    if (n > v->count) n = v->count;
+    if (n == 0) return;
+    uint32_t step = atomic_load_explicit(&v->step, memory_order_relaxed) + 1;
+    // Retire the previous step's cursors before its bound changes: a thief
+    // still holding an old cursor that is only exhausted against the old n
+    // must not see the new n and then win its CAS
+    for (int t = 0; t < v->worker_count; ++t)
+        atomic_store_explicit(&v->workers[t].cursor, (uint64_t)step << 32, memory_order_relaxed);
+    atomic_store_explicit(&v->step_n, n, memory_order_release);
+    v->actions = actions;
+    v->repeat = repeat > 0 ? repeat : 1;
+    atomic_store_explicit(&v->remaining, n, memory_order_relaxed);
+    // Publishes everything above to the workers
+    atomic_store(&v->step, step);
+    vec_wake_sleepers(v);
+
+    vec_work(v, -1, step);
+    for (int k = 0; atomic_load_explicit(&v->remaining, memory_order_acquire) != 0; ++k) {
+        if (k < NES_VEC_SPINS) cpu_relax();
+        else sched_yield();
+    }
+}
+
+const uint32_t *nes_vec_observations(const NesVec *v) {
+    return v->obs;
+}
+
+const float *nes_vec_rewards(const NesVec *v) {
+    return v->rewards;
+}
+
+NES *nes_vec_env(NesVec *v, size_t i) {
+    return i < v->count ? v->envs[i] : NULL;
+}
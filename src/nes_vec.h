@@ -0,0 +1,47 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "nes.h"
+
+// Vectorized environments for reinforcement learning: N independent clones
+// of one NES, stepped together by a fixed pool of pinned worker threads.
+//
+// Worker w owns a contiguous block of environments. It creates them itself,
+// in its own arena and from its own thread, so their memory (and their
+// slice of the observation buffer) is first touched on that worker's NUMA
+// node; only the ROM image is shared, read-only. A step hands each worker
+// its block through a per-worker atomic cursor; a worker that runs out
+// steals from the others' cursors. Cursors carry the step number, so a late
+// thief can never claim an item of the next step. Workers spin between
+// steps and only sleep on a condition variable after a long idle spell, so
+// back-to-back steps take no lock.
+typedef struct NesVec NesVec;
+
+// Reward for env after one emulated frame (e.g. a score read from RAM);
+// summed over the frames of a step. Called on worker threads.
+typedef float (*NesVecRewardFn)(void *user, const NES *nes, size_t env);
+
+#define NES_VEC_OBS_PIXELS (256 * 240)
+
+// count clones of base (a loaded, reset NES; it is only read, and may be
+// freed afterwards). threads <= 0 means one per online CPU; workers are
+// pinned to CPUs in order where the OS allows. NULL on failure.
+NesVec *nes_vec_create(const NES *base, size_t count, int threads);
+void nes_vec_destroy(NesVec *v);
+size_t nes_vec_count(const NesVec *v);
+// Set before stepping; NULL (the default) leaves rewards at 0
+void nes_vec_set_reward(NesVec *v, NesVecRewardFn fn, void *user);
+
+// Advance envs [0, n) by repeat frames each (action repeat; at least 1),
+// with actions[i] held on env i's first pad. Only the last frame of a step
+// is drawn. Returns when every env is done. Not reentrant.
+void nes_vec_step(NesVec *v, size_t n, const uint8_t *actions, int repeat);
+
+// Contiguous results of the last step: count observations of
+// NES_VEC_OBS_PIXELS 0xAARRGGBB pixels each (env i at i * NES_VEC_OBS_PIXELS,
+// page aligned), and count rewards
+const uint32_t *nes_vec_observations(const NesVec *v);
+const float *nes_vec_rewards(const NesVec *v);
+
+// One environment, for resets, save states or the second pad between steps
+NES *nes_vec_env(NesVec *v, size_t i);
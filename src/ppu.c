@@ -1,6 +1,9 @@
 #include "ppu.h"
 #include "cartridge.h"
+#include "mapper.h"
 #include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
 
@@ -9,22 +12,20 @@ static uint8_t ppu_read_mem(PPU *p, uint16_t addr);
 static void ppu_write_mem(PPU *p, uint16_t addr, uint8_t data);
 static const uint32_t NES_PALETTE[64];
 
-// Debug
-static bool g_ppu_debug = false;
-static int g_ppu_dbg_count = 0;
-static const int g_ppu_dbg_limit = 400;
+// Debug trace, per PPU
+#define PPU_DEBUG_LIMIT 400
 
-static inline void ppu_dbgf(const char *fmt, ...) {
-    if (!g_ppu_debug) return;
-    if (g_ppu_dbg_count >= g_ppu_dbg_limit) return;
-    g_ppu_dbg_count++;
+static inline void ppu_dbgf(PPU *p, const char *fmt, ...) {
+    if (!p->debug) return;
+    if (p->debug_count >= PPU_DEBUG_LIMIT) return;
+    p->debug_count++;
     va_list ap; va_start(ap, fmt);
     vfprintf(stderr, fmt, ap);
     va_end(ap);
 }
 
-void ppu_set_debug(bool on) {
-    g_ppu_debug = on; g_ppu_dbg_count = 0;
+void ppu_set_debug(PPU *p, bool on) {
+    p->debug = on; p->debug_count = 0;
 }
 
 // (no per-scanline trace function in original)
@@ -32,10 +33,21 @@ void ppu_set_debug(bool on) {
 // NTSC PPU timing
 #define PPU_SCANLINES 262
 #define PPU_DOTS_PER_LINE 341
+// Where A12 can rise within a rendered line: the first pattern fetch of each
+// sprite slot (8 dots apart) and the next-line background prefetch
+#define A12_SPRITE_DOT 260
+#define A12_BG_PREFETCH_DOT 324
 // CPU:PPU = 1:3
 
 void ppu_reset(PPU *p) {
+    // Buffers and the debug setting survive a reset
+    uint32_t *fb = p->framebuffer;
+    uint8_t *opaque = p->bg_opaque;
+    bool debug = p->debug;
     memset(p, 0, sizeof(*p));
+    p->framebuffer = fb;
+    p->bg_opaque = opaque;
+    p->debug = debug;
     p->ppustatus = 0xA0; // typical power-up pattern (bits 7,5 set variably)
     p->v = 0; p->t = 0; p->x_fine = 0; p->w = 0;
     p->scanline = 0; p->dot = 0;
@@ -45,9 +57,23 @@ void ppu_reset(PPU *p) {
 }
 
 void ppu_power_on(PPU *p) {
+    // Fresh struct: no buffers yet
+    p->framebuffer = NULL;
+    p->bg_opaque = NULL;
+    p->debug = false;
     ppu_reset(p);
 }
 
+bool ppu_alloc_framebuffer(PPU *p) {
+    if (!p->framebuffer) p->framebuffer = (uint32_t*)calloc(256 * 240, sizeof(uint32_t));
+    return p->framebuffer != NULL;
+}
+
+void ppu_free(PPU *p) {
+    free(p->framebuffer); p->framebuffer = NULL;
+    free(p->bg_opaque); p->bg_opaque = NULL;
+}
+
 static inline void inc_coarse_x(PPU *p) {
     if ((p->v & 0x001F) == 31) {
         p->v &= (uint16_t)~0x001F;         // coarse X = 0
@@ -84,6 +110,28 @@ static inline void transfer_vertical(PPU *p) {
     p->v = (uint16_t)((p->v & 0x041F) | (p->t & 0x7BE0));
 }
 
+// Work out where PPU A12 rises during the fetches after dot 257 of this
+// line: sprite slots read from their pattern table, then the background
+// prefetch reads from the background table. Nametable/attribute fetches
+// between pattern fetches are too short for the MMC3 filter, so the level
+// only changes with the table being read. Slots without a sprite fetch
+// tile $FF, which in 8x16 mode lives in the $1000 table.
+static void ppu_schedule_a12(PPU *p) {
+    bool bg_hi = (p->ppuctrl & 0x10) != 0;
+    bool tall = (p->ppuctrl & 0x20) != 0;
+    bool level = bg_hi; // held through the visible fetches
+    p->a12_count = 0;
+    p->a12_next = 0;
+    for (int i = 0; i < 8; ++i) {
+        bool hi;
+        if (!tall) hi = (p->ppuctrl & 0x08) != 0;
+        else hi = i < p->spr_count_next ? (p->oam[p->spr_index_next[i] * 4 + 1] & 1) != 0 : true;
+        if (hi && !level) p->a12_dot[p->a12_count++] = (uint16_t)(A12_SPRITE_DOT + 8 * i);
+        level = hi;
+    }
+    if (bg_hi && !level) p->a12_dot[p->a12_count++] = A12_BG_PREFETCH_DOT;
+}
+
 static void ppu_step(PPU *p) {
     // Advance one PPU cycle (dot)
     if (!p) return;
@@ -191,8 +239,7 @@ static void ppu_step(PPU *p) {
         if (!show_bg) { bg_opaque = false; }
         if (!show_spr) { use_sprite = false; }
         color = (use_sprite ? sp_color : bg_color);
-        p->framebuffer[y * 256 + x] = color;
-        p->bg_opaque[y * 256 + x] = bg_opaque ? 1 : 0;
+        if (p->framebuffer && !p->skip_draw) p->framebuffer[y * 256 + x] = color;
         if (sp0 && use_sprite && bg_opaque && x != 255) p->ppustatus |= 0x40; // sprite 0 hit
 
         // Now shift background shifters for next pixel
@@ -332,6 +379,14 @@ static void ppu_step(PPU *p) {
             }
         }
     }
+    // A12 edges for mappers that watch them: scheduled once per line, then
+    // delivered on their exact dot
+    if (rendering_on && (visible_line || pre_render) && dot == 257 && p->cart && p->cart->ops && p->cart->ops->a12_rise)
+        ppu_schedule_a12(p);
+    if (p->a12_next < p->a12_count && dot == p->a12_dot[p->a12_next]) {
+        p->a12_next++;
+        if (rendering_on) p->cart->ops->a12_rise(p->cart);
+    }
     // Dots 280-304 on pre-render: copy vertical bits from t to v
     if (rendering_on && pre_render && dot >= 280 && dot <= 304) transfer_vertical(p);
 
@@ -355,13 +410,20 @@ static inline uint16_t mirror_nt_addr(PPU *p, uint16_t addr) {
     uint16_t a = (uint16_t)((addr - 0x2000) & 0x0FFF); // 4*1KB region
     uint16_t table = (uint16_t)(a / 0x0400); // 0..3
     uint16_t offset = (uint16_t)(a & 0x03FF);
-    switch (p->mirror) {
+    // Mappers can switch mirroring at any time, so follow the cartridge
+    switch (p->cart ? p->cart->mirror : p->mirror) {
         case MIRROR_VERTICAL:
             if (table == 2) table = 0; else if (table == 3) table = 1;
             break;
         case MIRROR_HORIZONTAL:
             if (table == 1) table = 0; else if (table == 3) table = 2;
             break;
+        case MIRROR_SINGLE_LOW:
+            table = 0;
+            break;
+        case MIRROR_SINGLE_HIGH:
+            table = 1;
+            break;
         case MIRROR_FOUR:
         default:
             // 4-screen: map 0..3 to 0..3 collapsed into 2KB (not fully supported), fallback to vertical
@@ -375,8 +437,7 @@ static uint8_t ppu_read_mem(PPU *p, uint16_t addr) {
     addr &= 0x3FFF; // PPU address space wraps every 16KB
     if (addr < 0x2000) {
         // Pattern tables from CHR
-        if (!p->cart || !p->cart->chr || p->cart->chr_size == 0) return 0;
-        return p->cart->chr[addr % p->cart->chr_size];
+        return p->cart ? cart_ppu_read(p->cart, addr) : 0;
     } else if (addr < 0x3F00) {
         uint16_t nt = mirror_nt_addr(p, addr);
         return p->vram[nt];
@@ -397,9 +458,7 @@ static void ppu_write_mem(PPU *p, uint16_t addr, uint8_t data) {
     addr &= 0x3FFF; // PPU address space wraps every 16KB
     if (addr < 0x2000) {
         // CHR RAM writes only if cartridge has CHR RAM
-        if (p->cart && p->cart->chr && p->cart->chr_is_ram) {
-            p->cart->chr[addr % p->cart->chr_size] = data;
-        }
+        if (p->cart) cart_ppu_write(p->cart, addr, data);
     } else if (addr < 0x3F00) {
         uint16_t nt = mirror_nt_addr(p, addr);
         p->vram[nt] = data;
@@ -410,9 +469,7 @@ static void ppu_write_mem(PPU *p, uint16_t addr, uint8_t data) {
         if (pal == 0x18) pal = 0x08;
         if (pal == 0x1C) pal = 0x0C;
         p->palette[pal] = data;
-        if (g_ppu_debug && g_ppu_dbg_count < g_ppu_dbg_limit) {
-            ppu_dbgf("PPU: PALETTE[%02X] <= %02X\n", pal, data);
-        }
+        ppu_dbgf(p, "PPU: PALETTE[%02X] <= %02X\n", pal, data);
     } else {
         (void)data;
     }
@@ -460,11 +517,11 @@ void ppu_write_reg(PPU *p, uint16_t reg, uint8_t data) {
             p->ppuctrl = data;
             // Update t nametable bits (10-11)
             p->t = (uint16_t)((p->t & 0xF3FF) | ((data & 0x03) << 10));
-            ppu_dbgf("PPU: $2000 (PPUCTRL) <= %02X  t=%04X\n", data, p->t);
+            ppu_dbgf(p, "PPU: $2000 (PPUCTRL) <= %02X  t=%04X\n", data, p->t);
             break;
         case 1: // PPUMASK
             p->ppumask = data;
-            ppu_dbgf("PPU: $2001 (PPUMASK) <= %02X  showBG=%d showSP=%d\n", data, (data&0x08)!=0, (data&0x10)!=0);
+            ppu_dbgf(p, "PPU: $2001 (PPUMASK) <= %02X  showBG=%d showSP=%d\n", data, (data&0x08)!=0, (data&0x10)!=0);
             break;
         case 3: p->oamaddr = data; break;           // OAMADDR
         case 4: { // OAMDATA
@@ -478,7 +535,7 @@ void ppu_write_reg(PPU *p, uint16_t reg, uint8_t data) {
                 // coarse X bits 0-4
                 p->t = (uint16_t)((p->t & 0xFFE0) | (data >> 3));
                 p->w = 1;
-                ppu_dbgf("PPU: $2005 (SCROLL) X <= %02X  t=%04X x_fine=%d\n", data, p->t, p->x_fine);
+                ppu_dbgf(p, "PPU: $2005 (SCROLL) X <= %02X  t=%04X x_fine=%d\n", data, p->t, p->x_fine);
             } else {
                 // Y scroll
                 // fine Y bits 12-14
@@ -486,7 +543,7 @@ void ppu_write_reg(PPU *p, uint16_t reg, uint8_t data) {
                 // coarse Y bits 5-9
                 p->t = (uint16_t)((p->t & 0xFC1F) | ((data & 0xF8) << 2));
                 p->w = 0;
-                ppu_dbgf("PPU: $2005 (SCROLL) Y <= %02X  t=%04X\n", data, p->t);
+                ppu_dbgf(p, "PPU: $2005 (SCROLL) Y <= %02X  t=%04X\n", data, p->t);
             }
             break;
         }
@@ -494,19 +551,17 @@ void ppu_write_reg(PPU *p, uint16_t reg, uint8_t data) {
             if (p->w == 0) {
                 p->t = (uint16_t)((p->t & 0x00FF) | ((data & 0x3F) << 8));
                 p->w = 1;
-                ppu_dbgf("PPU: $2006 (ADDR) hi <= %02X  t=%04X\n", data, p->t);
+                ppu_dbgf(p, "PPU: $2006 (ADDR) hi <= %02X  t=%04X\n", data, p->t);
             } else {
                 p->t = (uint16_t)((p->t & 0xFF00) | data);
                 p->v = p->t;
                 p->w = 0;
-                ppu_dbgf("PPU: $2006 (ADDR) lo <= %02X  v=%04X\n", data, p->v);
+                ppu_dbgf(p, "PPU: $2006 (ADDR) lo <= %02X  v=%04X\n", data, p->v);
             }
             break;
         }
         case 7: { // PPUDATA
-            if (g_ppu_debug) {
-                ppu_dbgf("PPU: $2007 (DATA) write @ %04X <= %02X\n", p->v, data);
-            }
+            ppu_dbgf(p, "PPU: $2007 (DATA) write @ %04X <= %02X\n", p->v, data);
             ppu_write_mem(p, p->v, data);
             uint16_t inc = (p->ppuctrl & 0x04) ? 32 : 1;
             p->v = (uint16_t)(p->v + inc);
@@ -519,11 +574,48 @@ void ppu_write_reg(PPU *p, uint16_t reg, uint8_t data) {
     }
 }
 
-void ppu_connect_cartridge(PPU *p, const Cartridge *cart, MirrorMode mirror) {
+void ppu_connect_cartridge(PPU *p, Cartridge *cart, MirrorMode mirror) {
     p->cart = cart;
     p->mirror = mirror;
 }
 
+// Save-state coverage: everything except the framebuffer and bg_opaque
+// (rebuilt as the next frame renders) and the cartridge link
+static const struct { size_t begin, end; } PPU_STATE_SPANS[] = {
+    { 0, offsetof(PPU, bg_opaque) },
+    { offsetof(PPU, vram_addr_hi), offsetof(PPU, cart) },
+    { offsetof(PPU, mirror), offsetof(PPU, mirror) + sizeof(MirrorMode) },
+    { offsetof(PPU, scanline), sizeof(PPU) },
+};
+#define PPU_STATE_SPAN_COUNT (sizeof(PPU_STATE_SPANS) / sizeof(PPU_STATE_SPANS[0]))
+
+size_t ppu_state_size(void) {
+    size_t size = 0;
+    for (size_t i = 0; i < PPU_STATE_SPAN_COUNT; ++i) size += PPU_STATE_SPANS[i].end - PPU_STATE_SPANS[i].begin;
+    return size;
+}
+
+size_t ppu_save_state(const PPU *p, void *buf) {
+    uint8_t *out = (uint8_t*)buf;
+    for (size_t i = 0; i < PPU_STATE_SPAN_COUNT; ++i) {
+        size_t len = PPU_STATE_SPANS[i].end - PPU_STATE_SPANS[i].begin;
+        memcpy(out, (const uint8_t*)p + PPU_STATE_SPANS[i].begin, len);
+        out += len;
+    }
+    return (size_t)(out - (uint8_t*)buf);
+}
+
+bool ppu_load_state(PPU *p, const void *buf, size_t len) {
+    if (len != ppu_state_size()) return false;
+    const uint8_t *in = (const uint8_t*)buf;
+    for (size_t i = 0; i < PPU_STATE_SPAN_COUNT; ++i) {
+        size_t n = PPU_STATE_SPANS[i].end - PPU_STATE_SPANS[i].begin;
+        memcpy((uint8_t*)p + PPU_STATE_SPANS[i].begin, in, n);
+        in += n;
+    }
+    return true;
+}
+
 // Classic NES palette (approx.)
 static const uint32_t NES_PALETTE[64] = {
     0xFF757575,0xFF271B8F,0xFF0000AB,0xFF47009F,0xFF8F0077,0xFFAB0013,0xFFA70000,0xFF7F0B00,
@@ -537,6 +629,8 @@ static const uint32_t NES_PALETTE[64] = {
 };
 
 const uint32_t *ppu_render_frame(PPU *p) {
+    if (!ppu_alloc_framebuffer(p)) return NULL;
+    if (!p->bg_opaque && !(p->bg_opaque = (uint8_t*)malloc(256 * 240))) return NULL;
     // Background with loopy regs (approximate)
     uint16_t pattern_base = (p->ppuctrl & 0x10) ? 0x1000 : 0x0000; // BG pattern table
     uint16_t v = p->v;
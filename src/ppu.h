@@ -24,7 +24,7 @@ typedef struct {
     uint8_t vram[2 * 1024];     // Nametables (2KB) with mirroring
     uint8_t palette[32];        // Palette RAM $3F00-$3F1F
     uint8_t oam[256];           // Object Attribute Memory
-    uint8_t bg_opaque[256*240]; // Track BG non-transparent pixels for sprite priority
+    uint8_t *bg_opaque;         // BG opacity for ppu_render_frame's sprite priority (allocated there)
     uint8_t vram_addr_hi;       // internal address latch high/low for $2006
     uint8_t vram_addr_lo;
     uint16_t vram_addr;         // current VRAM address
@@ -38,12 +38,17 @@ typedef struct {
     uint8_t scroll_x;           // from $2005 first write
     uint8_t scroll_y;           // from $2005 second write
 
-    // Cartridge link for CHR access and mirroring
-    const Cartridge *cart;
-    MirrorMode mirror;
+    // Cartridge link for CHR access, mirroring and the mapper scanline hook
+    Cartridge *cart;
+    MirrorMode mirror;          // used when no cartridge is connected
 
-    // Framebuffer (ARGB8888)
-    uint32_t framebuffer[256 * 240];
+    // Framebuffer (ARGB8888, 256x240). Pixels are only stored once it has
+    // been allocated with ppu_alloc_framebuffer; without it the PPU still
+    // runs (sprite 0 hits, timing) but draws nothing.
+    uint32_t *framebuffer;
+    bool skip_draw;             // leave the framebuffer alone (speculative frames)
+    bool debug;                 // trace register writes to stderr (ppu_set_debug)
+    int debug_count;            // lines traced; stops at a fixed limit
 
     // Current position (for per-dot stepping)
     int scanline;
@@ -76,10 +81,19 @@ typedef struct {
     uint8_t spr_hi_next[8];
     uint8_t spr_index_next[8];
 
+    // Pattern-table A12 rising edges for the current line, as dots, for
+    // mappers that count them (MMC3). Scheduled at sprite evaluation.
+    uint16_t a12_dot[9];
+    uint8_t a12_count;
+    uint8_t a12_next;
+
 } PPU;
 
 void ppu_reset(PPU *p);
 void ppu_power_on(PPU *p);
+bool ppu_alloc_framebuffer(PPU *p);
+// Release the framebuffer and render scratch
+void ppu_free(PPU *p);
 
 // Advance PPU time by CPU cycles; generate VBlank NMI at ~60Hz
 void ppu_tick_cpu_cycles(PPU *p, int cycles);
@@ -89,10 +103,16 @@ uint8_t ppu_read_reg(PPU *p, uint16_t reg);
 void ppu_write_reg(PPU *p, uint16_t reg, uint8_t data);
 
 // ROM integration
-void ppu_connect_cartridge(PPU *p, const Cartridge *cart, MirrorMode mirror);
+void ppu_connect_cartridge(PPU *p, Cartridge *cart, MirrorMode mirror);
+
+// Save states: registers, memories and the in-progress scanline state, in
+// host layout (the framebuffer, bg_opaque and cartridge link are left out)
+size_t ppu_state_size(void);
+size_t ppu_save_state(const PPU *p, void *buf);
+bool ppu_load_state(PPU *p, const void *buf, size_t len);
 
 // Render background into framebuffer (very simplified). Returns pointer to ARGB pixels.
 const uint32_t *ppu_render_frame(PPU *p);
 
-// Debug controls
-void ppu_set_debug(bool on);
+// Debug controls: trace this PPU's register writes (first 400 lines)
+void ppu_set_debug(PPU *p, bool on);
@@ -0,0 +1,215 @@
+#define _POSIX_C_SOURCE 200809L
+#include "rewind.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Zero runs shorter than this stay inside a literal; a token costs two
+// varints, so breaking for a short run would grow the output
+#define REWIND_MIN_ZERO_RUN 8
+// Initial record index size; it doubles as needed up to a quarter of the
+// budget (16 bytes per record)
+#define REWIND_INITIAL_RECORDS 1024
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint8_t *put_varint(uint8_t *out, size_t v) {
+    while (v >= 0x80) { *out++ = (uint8_t)(v | 0x80); v >>= 7; }
+    *out++ = (uint8_t)v;
+    return out;
+}
+
+static const uint8_t *get_varint(const uint8_t *in, const uint8_t *end, size_t *v) {
+    size_t x = 0;
+    int shift = 0;
+    while (in < end && shift < 64) {
+        uint8_t b = *in++;
+        x |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) { *v = x; return in; }
+        shift += 7;
+    }
+    return NULL;
+}
+
+// Zero bytes from p up to end, 8 at a time
+static size_t zero_run(const uint8_t *p, const uint8_t *end) {
+    const uint8_t *s = p;
+    while (end - p >= 8) {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        if (w) break;
+        p += 8;
+    }
+    while (p < end && *p == 0) ++p;
+    return (size_t)(p - s);
+}
+
+// Delta as (zero run, literal length, literal bytes) tokens
+static size_t rle_encode(const uint8_t *in, size_t n, uint8_t *out) {
+    const uint8_t *p = in, *end = in + n;
+    uint8_t *o = out;
+    while (p < end) {
+        size_t zeros = zero_run(p, end);
+        p += zeros;
+        const uint8_t *lit = p;
+        size_t run = 0;
+        while (p < end) {
+            run = *p ? 0 : run + 1;
+            ++p;
+            if (run == REWIND_MIN_ZERO_RUN) { p -= run; break; }
+        }
+        size_t lit_len = (size_t)(p - lit);
+        o = put_varint(o, zeros);
+        o = put_varint(o, lit_len);
+        memcpy(o, lit, lit_len);
+        o += lit_len;
+    }
+    return (size_t)(o - out);
+}
+
+// XOR a packed delta into dst (n bytes)
+static bool rle_apply(uint8_t *dst, size_t n, const uint8_t *in, size_t len) {
+    const uint8_t *end = in + len;
+    size_t pos = 0, zeros, lit;
+    while (in < end) {
+        if (!(in = get_varint(in, end, &zeros)) || !(in = get_varint(in, end, &lit))) return false;
+        if (zeros > n - pos || lit > n - pos - zeros || lit > (size_t)(end - in)) return false;
+        pos += zeros;
+        for (size_t i = 0; i < lit; ++i) dst[pos + i] ^= in[i];
+        pos += lit;
+        in += lit;
+    }
+    return true;
+}
+
+bool rewind_init(Rewind *r, const NES *nes, size_t budget_bytes, int interval) {
+    memset(r, 0, sizeof(*r));
+    r->state_size = nes_state_size(nes);
+    r->ring_size = budget_bytes;
+    r->rec_cap = REWIND_INITIAL_RECORDS;
+    r->interval = interval > 0 ? interval : 1;
+    r->head = (uint8_t*)malloc(r->state_size);
+    r->scratch = (uint8_t*)malloc(r->state_size);
+    // Tokens after the first skip at least REWIND_MIN_ZERO_RUN bytes, more
+    // than their varints cost, so output is at most the input plus a few bytes
+    r->packed = (uint8_t*)malloc(r->state_size + r->state_size / 4 + 32);
+    r->ring = (uint8_t*)malloc(r->ring_size);
+    r->rec_off = (size_t*)malloc(r->rec_cap * sizeof(size_t));
+    r->rec_len = (size_t*)malloc(r->rec_cap * sizeof(size_t));
+    if (!r->head || !r->scratch || !r->packed || !r->ring || !r->rec_off || !r->rec_len) {
+        rewind_free(r);
+        return false;
+    }
+    return true;
+}
+
+void rewind_free(Rewind *r) {
+    if (!r) return;
+    free(r->head); free(r->scratch); free(r->packed); free(r->ring);
+    free(r->rec_off); free(r->rec_len);
+    memset(r, 0, sizeof(*r));
+}
+
+// Double the record index, unrolling the circle so rec_first becomes 0
+static bool rewind_grow_index(Rewind *r) {
+    size_t cap = r->rec_cap * 2;
+    if (cap * 2 * sizeof(size_t) > r->ring_size / 4) return false;
+    size_t *off = (size_t*)malloc(cap * sizeof(size_t));
+    size_t *len = (size_t*)malloc(cap * sizeof(size_t));
+    if (!off || !len) { free(off); free(len); return false; }
+    for (size_t i = 0; i < r->rec_count; ++i) {
+        size_t j = (r->rec_first + i) % r->rec_cap;
+        off[i] = r->rec_off[j];
+        len[i] = r->rec_len[j];
+    }
+    free(r->rec_off); free(r->rec_len);
+    r->rec_off = off; r->rec_len = len;
+    r->rec_cap = cap;
+    r->rec_first = 0;
+    return true;
+}
+
+static void rewind_drop_oldest(Rewind *r) {
+    r->rec_first = (r->rec_first + 1) % r->rec_cap;
+    --r->rec_count;
+}
+
+// Append a packed delta after the newest record, evicting the oldest ones
+// it would overwrite. Live records run in offset order from the oldest, with
+// at most one wrap to offset 0, so eviction only ever needs the oldest.
+static bool rewind_store(Rewind *r, const uint8_t *data, size_t len) {
+    if (len > r->ring_size) return false;
+    size_t at = 0;
+    if (r->rec_count) {
+        size_t last = (r->rec_first + r->rec_count - 1) % r->rec_cap;
+        at = r->rec_off[last] + r->rec_len[last];
+        if (at + len > r->ring_size) {
+            // Wrapping: the records past the newest one are the oldest of all
+            // and must go before the ones at offset 0 can
+            while (r->rec_count && r->rec_off[r->rec_first] >= at) rewind_drop_oldest(r);
+            at = 0;
+        }
+    }
+    if (r->rec_count == r->rec_cap && !rewind_grow_index(r)) rewind_drop_oldest(r);
+    while (r->rec_count) {
+        size_t off = r->rec_off[r->rec_first];
+        if (off >= at + len || off + r->rec_len[r->rec_first] <= at) break;
+        rewind_drop_oldest(r);
+    }
+    size_t idx = (r->rec_first + r->rec_count) % r->rec_cap;
+    memcpy(r->ring + at, data, len);
+    r->rec_off[idx] = at;
+    r->rec_len[idx] = len;
+    ++r->rec_count;
+    return true;
+}
+
+void rewind_frame(Rewind *r, const NES *nes) {
+    if (!r->ring || --r->countdown > 0) return;
+    r->countdown = r->interval;
+    uint64_t t0 = now_ns();
+    if (!nes_save_state(nes, r->scratch, r->state_size)) return;
+    if (r->have_head) {
+        // The delta that turns the new head back into the old one
+        uint8_t *d = r->scratch, *h = r->head;
+        for (size_t i = 0; i < r->state_size; ++i) {
+            uint8_t x = d[i] ^ h[i];
+            h[i] = d[i];
+            d[i] = x;
+        }
+        size_t len = rle_encode(r->scratch, r->state_size, r->packed);
+        if (!rewind_store(r, r->packed, len)) r->rec_count = 0; // larger than the budget: restart
+        r->packed_bytes += len;
+    } else {
+        memcpy(r->head, r->scratch, r->state_size);
+        r->have_head = true;
+    }
+    ++r->snapshots;
+    r->snapshot_ns += now_ns() - t0;
+}
+
+bool rewind_step_back(Rewind *r, NES *nes) {
+    if (!r->have_head) return false;
+    bool ok = nes_load_state(nes, r->head, r->state_size);
+    if (r->rec_count) {
+        size_t last = (r->rec_first + r->rec_count - 1) % r->rec_cap;
+        if (!rle_apply(r->head, r->state_size, r->ring + r->rec_off[last], r->rec_len[last])) {
+            r->rec_count = 0;
+            r->have_head = false;
+        } else {
+            --r->rec_count;
+        }
+    } else {
+        r->have_head = false;
+    }
+    r->countdown = r->interval;
+    return ok;
+}
+
+size_t rewind_depth(const Rewind *r) {
+    return r->have_head ? r->rec_count + 1 : 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "nes.h"
+
+// Rewind history: a save state every `interval` frames, kept in a fixed
+// memory budget. Only the newest snapshot is stored whole; each older one is
+// the XOR against its successor, run-length coded (consecutive states differ
+// in a few hundred bytes, so most deltas are mostly zero runs). Stepping back
+// loads the newest snapshot and un-XORs the next delta into place. When the
+// budget fills, the oldest deltas are dropped.
+typedef struct {
+    size_t state_size;
+    uint8_t *head;      // newest snapshot, uncompressed
+    bool have_head;
+    uint8_t *scratch;   // incoming state, then the XOR delta
+    uint8_t *packed;    // encoder output, worst case for one delta
+
+    // Byte ring of packed deltas, oldest to newest; a record never wraps
+    uint8_t *ring;
+    size_t ring_size;
+    size_t *rec_off, *rec_len; // circular index of records
+    size_t rec_cap, rec_first, rec_count;
+
+    int interval;
+    int countdown;      // frames until the next snapshot
+
+    // Stats
+    uint64_t snapshots;
+    uint64_t packed_bytes;
+    uint64_t snapshot_ns;
+} Rewind;
+
+// budget_bytes covers the ring; the record index may add up to a quarter
+// of that, and the head and work buffers about three states. interval >= 1.
+bool rewind_init(Rewind *r, const NES *nes, size_t budget_bytes, int interval);
+void rewind_free(Rewind *r);
+// Call once per emulated frame; takes a snapshot every interval frames
+void rewind_frame(Rewind *r, const NES *nes);
+// Load the newest snapshot and drop it from the history. False when there
+// is nothing left to go back to.
+bool rewind_step_back(Rewind *r, NES *nes);
+// Snapshots currently held (including the uncompressed newest one)
+size_t rewind_depth(const Rewind *r);
@@ -0,0 +1,197 @@
+#define _POSIX_C_SOURCE 200809L
+#include "romdb.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cartridge.h"
+
+// Loaded entries, sorted by CRC with one entry per CRC, for bsearch.
+// seq orders entries by load so the newest wins when a file repeats a CRC.
+typedef struct {
+    RomDbEntry e;
+    uint64_t seq;
+} RomDbSlot;
+
+static RomDbSlot *g_db;
+static size_t g_db_count, g_db_cap;
+static uint64_t g_db_seq;
+// Lookups (one per cartridge load, possibly from several libnes threads)
+// share the lock; only romdb_load/romdb_clear take it exclusively
+static pthread_rwlock_t g_db_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// Slice-by-8: eight 256-entry tables let the loop fold 8 input bytes per
+// iteration with independent lookups instead of one dependent lookup per byte
+static uint32_t CRC_TABLE[8][256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_build_tables(void) {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        CRC_TABLE[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (int t = 1; t < 8; ++t) {
+            uint32_t prev = CRC_TABLE[t - 1][i];
+            CRC_TABLE[t][i] = (prev >> 8) ^ CRC_TABLE[0][prev & 0xFF];
+        }
+    }
+}
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len) {
+    pthread_once(&crc_once, crc_build_tables);
+    const uint8_t *p = (const uint8_t*)data;
+    crc = ~crc;
+    while (len >= 8) {
+        // Assembled byte by byte, so alignment and host byte order don't matter
+        uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+        crc = CRC_TABLE[7][lo & 0xFF] ^ CRC_TABLE[6][(lo >> 8) & 0xFF] ^
+              CRC_TABLE[5][(lo >> 16) & 0xFF] ^ CRC_TABLE[4][lo >> 24] ^
+              CRC_TABLE[3][hi & 0xFF] ^ CRC_TABLE[2][(hi >> 8) & 0xFF] ^
+              CRC_TABLE[1][(hi >> 16) & 0xFF] ^ CRC_TABLE[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = (crc >> 8) ^ CRC_TABLE[0][(crc ^ *p++) & 0xFF];
+    return ~crc;
+}
+
+static bool parse_int_field(const char *tok, int32_t *out) {
+    if (strcmp(tok, "-") == 0) { *out = ROMDB_KEEP; return true; }
+    char *end;
+    long v = strtol(tok, &end, 10);
+    if (*end != '\0' || v < 0 || v > 0x7FFFFFFF) return false;
+    *out = (int32_t)v;
+    return true;
+}
+
+static bool parse_line(char *line, RomDbEntry *e) {
+    char *save = NULL;
+    char *tok[7];
+    for (int i = 0; i < 7; ++i) {
+        tok[i] = strtok_r(i == 0 ? line : NULL, " \t\r\n", &save);
+        if (!tok[i]) return false;
+    }
+    char *end;
+    unsigned long crc = strtoul(tok[0], &end, 16);
+    if (*end != '\0' || crc > 0xFFFFFFFFul) return false;
+    e->crc = (uint32_t)crc;
+
+    e->mapper = ROMDB_KEEP;
+    e->submapper = ROMDB_KEEP;
+    if (strcmp(tok[1], "-") != 0) {
+        long m = strtol(tok[1], &end, 10);
+        if (m < 0 || m > 4095) return false;
+        e->mapper = (int16_t)m;
+        if (*end == '.') {
+            long sub = strtol(end + 1, &end, 10);
+            if (sub < 0 || sub > 15) return false;
+            e->submapper = (int8_t)sub;
+        }
+        if (*end != '\0') return false;
+    }
+
+    static const struct { const char *name; MirrorMode mode; } MIRRORS[] = {
+        { "h", MIRROR_HORIZONTAL }, { "v", MIRROR_VERTICAL }, { "4", MIRROR_FOUR },
+        { "1a", MIRROR_SINGLE_LOW }, { "1b", MIRROR_SINGLE_HIGH },
+    };
+    e->mirror = ROMDB_KEEP;
+    if (strcmp(tok[2], "-") != 0) {
+        for (size_t i = 0; i < sizeof(MIRRORS) / sizeof(MIRRORS[0]); ++i)
+            if (strcmp(tok[2], MIRRORS[i].name) == 0) e->mirror = (int8_t)MIRRORS[i].mode;
+        if (e->mirror == ROMDB_KEEP) return false;
+    }
+
+    int32_t battery;
+    if (!parse_int_field(tok[3], &e->prg_ram) || !parse_int_field(tok[4], &e->chr_ram) ||
+        !parse_int_field(tok[5], &battery) || battery > 1) return false;
+    e->battery = (int8_t)battery;
+
+    static const char *const TIMINGS[] = {
+        [CART_TIMING_NTSC] = "ntsc", [CART_TIMING_PAL] = "pal",
+        [CART_TIMING_MULTI] = "multi", [CART_TIMING_DENDY] = "dendy",
+    };
+    e->timing = ROMDB_KEEP;
+    if (strcmp(tok[6], "-") != 0) {
+        for (int i = 0; i < 4; ++i) if (strcmp(tok[6], TIMINGS[i]) == 0) e->timing = (int8_t)i;
+        if (e->timing == ROMDB_KEEP) return false;
+    }
+    return true;
+}
+
+static int slot_cmp(const void *a, const void *b) {
+    const RomDbSlot *x = (const RomDbSlot*)a, *y = (const RomDbSlot*)b;
+    if (x->e.crc != y->e.crc) return x->e.crc < y->e.crc ? -1 : 1;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int crc_cmp(const void *key, const void *slot) {
+    uint32_t crc = *(const uint32_t*)key, other = ((const RomDbSlot*)slot)->e.crc;
+    return crc < other ? -1 : crc > other;
+}
+
+// Sort after appending, keeping only the newest entry of each CRC
+static void db_sort(void) {
+    if (g_db_count < 2) return;
+    qsort(g_db, g_db_count, sizeof(RomDbSlot), slot_cmp);
+    size_t out = 0;
+    for (size_t i = 0; i < g_db_count; ++i) {
+        if (out > 0 && g_db[out - 1].e.crc == g_db[i].e.crc) g_db[out - 1] = g_db[i];
+        else g_db[out++] = g_db[i];
+    }
+    g_db_count = out;
+}
+
+int romdb_load(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[256];
+    int added = 0, lineno = 0;
+    pthread_rwlock_wrlock(&g_db_lock);
+    while (fgets(line, sizeof(line), f)) {
+        ++lineno;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *p = line;
+        while (*p == ' ' || *p == '\t') ++p;
+        if (*p == '\0' || *p == '\n' || *p == '\r') continue;
+        RomDbEntry e;
+        if (!parse_line(p, &e)) {
+            fprintf(stderr, "Warning: %s:%d: bad ROM database entry.\n", path, lineno);
+            continue;
+        }
+        if (g_db_count == g_db_cap) {
+            size_t cap = g_db_cap ? g_db_cap * 2 : 64;
+            RomDbSlot *grown = (RomDbSlot*)realloc(g_db, cap * sizeof(RomDbSlot));
+            if (!grown) break;
+            g_db = grown;
+            g_db_cap = cap;
+        }
+        g_db[g_db_count].e = e;
+        g_db[g_db_count].seq = g_db_seq++;
+        ++g_db_count;
+        ++added;
+    }
+    db_sort();
+    pthread_rwlock_unlock(&g_db_lock);
+    fclose(f);
+    return added;
+}
+
+void romdb_clear(void) {
+    pthread_rwlock_wrlock(&g_db_lock);
+    free(g_db);
+    g_db = NULL;
+    g_db_count = g_db_cap = 0;
+    pthread_rwlock_unlock(&g_db_lock);
+}
+
+bool romdb_lookup(uint32_t crc, RomDbEntry *out) {
+    pthread_rwlock_rdlock(&g_db_lock);
+    const RomDbSlot *slot = g_db_count ? (const RomDbSlot*)bsearch(&crc, g_db, g_db_count, sizeof(RomDbSlot), crc_cmp) : NULL;
+    if (slot) *out = slot->e;
+    pthread_rwlock_unlock(&g_db_lock);
+    return slot != NULL;
+}
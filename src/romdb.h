@@ -0,0 +1,40 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// ROM metadata database: corrections for bad or incomplete iNES headers,
+// loaded from files with romdb_load (none are compiled in),
+// keyed by the CRC32 of the ROM data (PRG ROM followed by CHR ROM, without
+// header or trainer; the same key No-Intro style databases use).
+
+// Field value meaning "keep what the header says"
+#define ROMDB_KEEP (-1)
+
+typedef struct {
+    uint32_t crc;
+    int16_t mapper;     // iNES/NES 2.0 mapper number
+    int8_t submapper;
+    int8_t mirror;      // MirrorMode
+    int32_t prg_ram;    // bytes, volatile + battery-backed
+    int32_t chr_ram;    // bytes
+    int8_t battery;     // 0/1
+    int8_t timing;      // CartTiming
+} RomDbEntry;
+
+// CRC-32 (IEEE 802.3, as zip/PNG), slice-by-8. Start with crc = 0 and chain
+// calls to hash discontiguous buffers.
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+// Add entries from a text file, one ROM per line:
+//   CRC32 MAPPER[.SUB] MIRROR PRG_RAM CHR_RAM BATTERY TIMING
+// MIRROR is h, v, 4, 1a (single-screen low) or 1b; RAM sizes in bytes;
+// TIMING is ntsc, pal, multi or dendy; '-' keeps the header's value; '#'
+// starts a comment. Entries loaded later take precedence over earlier ones.
+// Returns entries added, or -1 if the file cannot be read.
+int romdb_load(const char *path);
+// Drop entries added with romdb_load
+void romdb_clear(void);
+
+// Look a ROM up by CRC (binary search of the loaded entries)
+bool romdb_lookup(uint32_t crc, RomDbEntry *out);
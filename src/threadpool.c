@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct ThreadPool {
+    pthread_t *workers;
+    int worker_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;     // a job was posted, or quit
+    pthread_cond_t done;     // the last worker left the job
+    uint64_t generation;     // bumped per job
+    bool quit;
+    int busy;                // workers still inside the current job
+
+    // Current job
+    ThreadPoolFn fn;
+    void *ctx;
+    size_t count;
+    _Atomic size_t next;
+};
+
+static void threadpool_work(ThreadPool *pool) {
+    for (;;) {
+        size_t i = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed);
+        if (i >= pool->count) break;
+        pool->fn(pool->ctx, i);
+    }
+}
+
+static void *threadpool_main(void *arg) {
+    ThreadPool *pool = (ThreadPool*)arg;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->quit) pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->quit) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        threadpool_work(pool);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool *threadpool_create(int threads) {
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    ThreadPool *pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if (!pool) return NULL;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    atomic_init(&pool->next, 0);
+    pool->workers = (pthread_t*)calloc((size_t)threads, sizeof(pthread_t));
+    if (!pool->workers) { threadpool_destroy(pool); return NULL; }
+    // The caller is the last worker
+    for (int i = 0; i < threads - 1; ++i) {
+        if (pthread_create(&pool->workers[i], NULL, threadpool_main, pool) != 0) break;
+        ++pool->worker_count;
+    }
+    return pool;
+}
+
+void threadpool_destroy(ThreadPool *pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->worker_count; ++i) pthread_join(pool->workers[i], NULL);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+int threadpool_size(const ThreadPool *pool) {
+    return pool ? pool->worker_count + 1 : 1;
+}
+
+void threadpool_run(ThreadPool *pool, size_t count, ThreadPoolFn fn, void *ctx) {
+    if (count == 0) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->count = count;
+    atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+    pool->busy = pool->worker_count;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    threadpool_work(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
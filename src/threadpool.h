@@ -0,0 +1,17 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+// Fixed pool of worker threads for data-parallel jobs: threadpool_run calls
+// fn(ctx, i) for every i in [0, count) and returns when all are done. Items
+// are handed out one at a time from a shared atomic counter, so uneven items
+// balance themselves; the calling thread works too. One job at a time.
+typedef struct ThreadPool ThreadPool;
+typedef void (*ThreadPoolFn)(void *ctx, size_t index);
+
+// threads <= 0 means one per online CPU. NULL on failure.
+ThreadPool *threadpool_create(int threads);
+void threadpool_destroy(ThreadPool *pool);
+// Threads working on a job, including the caller
+int threadpool_size(const ThreadPool *pool);
+void threadpool_run(ThreadPool *pool, size_t count, ThreadPoolFn fn, void *ctx);
@@ -13,6 +13,7 @@ struct Video {
     int crop_l, crop_r, crop_t, crop_b;
     uint8_t pad1_state;
     uint8_t pad2_state;
+    bool rewind_held;
     SDL_Keycode map1[8];
     SDL_Keycode map2[8];
 };
@@ -62,7 +63,7 @@ void video_fill(Video *v, uint8_t r, uint8_t g, uint8_t b) {
     SDL_RenderPresent(v->ren);
 }
 
-void video_poll(Video *v, bool *quit, uint8_t *pad1_state, uint8_t *pad2_state) {
+void video_poll(Video *v, bool *quit, uint8_t *pad1_state, uint8_t *pad2_state, bool *rewind) {
     SDL_Event e;
     while (SDL_PollEvent(&e)) {
         if (e.type == SDL_QUIT) { *quit = true; }
@@ -70,6 +71,7 @@ void video_poll(Video *v, bool *quit, uint8_t *pad1_state, uint8_t *pad2_state)
         if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
             bool down = (e.type == SDL_KEYDOWN);
             SDL_Keycode k = e.key.keysym.sym;
+            if (k == SDLK_BACKSPACE) { v->rewind_held = down; continue; }
             uint8_t b = 0;
             int pad = 0; // 1 or 2
             for (int i = 0; i < 8; ++i) { if (k == v->map1[i]) { b = (uint8_t)i; pad = 1; break; } }
@@ -87,6 +89,7 @@ void video_poll(Video *v, bool *quit, uint8_t *pad1_state, uint8_t *pad2_state)
     }
     if (pad1_state) *pad1_state = v->pad1_state;
     if (pad2_state) *pad2_state = v->pad2_state;
+    if (rewind) *rewind = v->rewind_held;
 }
 
 void video_shutdown(Video **pv) {
@@ -155,8 +158,9 @@ bool video_init(Video **out, const char *title, int width, int height, int scale
     (void)out; (void)title; (void)width; (void)height; (void)scale; return false;
 }
 void video_fill(Video *v, uint8_t r, uint8_t g, uint8_t b) { (void)v; (void)r; (void)g; (void)b; }
-void video_poll(Video *v, bool *quit, uint8_t *pad1_state, uint8_t *pad2_state) { (void)v; (void)quit; if (pad1_state) *pad1_state = 0; if (pad2_state) *pad2_state = 0; }
+void video_poll(Video *v, bool *quit, uint8_t *pad1_state, uint8_t *pad2_state, bool *rewind) { (void)v; (void)quit; if (pad1_state) *pad1_state = 0; if (pad2_state) *pad2_state = 0; if (rewind) *rewind = false; }
 void video_shutdown(Video **v) { (void)v; }
 void video_present(Video *v, const uint32_t *pixels) { (void)v; (void)pixels; }
+bool video_parse_and_set_keymap(Video *v, int pad, const char *csv) { (void)v; (void)pad; (void)csv; return false; }
 
 #endif
@@ -6,8 +6,9 @@ typedef struct Video Video;
 
 bool video_init(Video **out, const char *title, int width, int height, int scale);
 void video_fill(Video *v, uint8_t r, uint8_t g, uint8_t b);
-// Polls events; updates quit flag and current pad states (A,B,Select,Start,Up,Down,Left,Right)
-void video_poll(Video *v, bool *quit, uint8_t *pad1_state, uint8_t *pad2_state);
+// Polls events; updates quit flag and current pad states (A,B,Select,Start,Up,Down,Left,Right).
+// *rewind (may be NULL) reports whether the rewind key (Backspace) is held.
+void video_poll(Video *v, bool *quit, uint8_t *pad1_state, uint8_t *pad2_state, bool *rewind);
 void video_shutdown(Video **v);
 // Present a 256x240 ARGB8888 buffer
 void video_present(Video *v, const uint32_t *pixels);
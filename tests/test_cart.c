@@ -0,0 +1,88 @@
+// Cartridge loader bounds: NES 2.0 headers can declare sizes that are not
+// whole 8KB PRG / 1KB CHR banks, which the bank tables cannot map. Such
+// images must be rejected; whole-bank ones must load and stay in bounds.
+//
+// Build and run: make test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cartridge.h"
+
+static int failures;
+
+#define CHECK(cond, what) do { \
+    if (!(cond)) { fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, what); ++failures; } \
+} while (0)
+
+// An NES 2.0 NROM image: header, prg_size bytes of PRG, chr_size of CHR
+static uint8_t *make_rom(uint8_t prg_lsb, uint8_t chr_lsb, uint8_t flags9, uint8_t flags11,
+                         size_t prg_size, size_t chr_size, size_t *size_out) {
+    size_t size = 16 + prg_size + chr_size;
+    uint8_t *rom = (uint8_t*)calloc(1, size);
+    if (!rom) exit(1);
+    memcpy(rom, "NES\x1A", 4);
+    rom[4] = prg_lsb;
+    rom[5] = chr_lsb;
+    rom[7] = 0x08; // NES 2.0
+    rom[9] = flags9;
+    rom[11] = flags11;
+    *size_out = size;
+    return rom;
+}
+
+static int load(uint8_t *rom, size_t size, Cartridge *cart) {
+    int rc = cartridge_load_mem(rom, size, cart);
+    free(rom);
+    return rc;
+}
+
+int main(void) {
+    Cartridge cart;
+    size_t size;
+    uint8_t *rom;
+
+    // CHR RAM of 128 bytes (shift count 1)
+    rom = make_rom(1, 0, 0x00, 0x01, 16 * 1024, 0, &size);
+    CHECK(load(rom, size, &cart) != 0, "128-byte CHR RAM rejected");
+
+    // CHR RAM of 8KB + 128 bytes (volatile + battery-backed)
+    rom = make_rom(1, 0, 0x00, 0x17, 16 * 1024, 0, &size);
+    CHECK(load(rom, size, &cart) != 0, "CHR RAM of 8KB + 128 bytes rejected");
+
+    // Exponent-form PRG ROM of 1 byte (2^0 * 1)
+    rom = make_rom(0x00, 0, 0x0F, 0x07, 1, 0, &size);
+    CHECK(load(rom, size, &cart) != 0, "1-byte PRG ROM rejected");
+
+    // Exponent-form PRG ROM of 24 bytes (2^3 * 3)
+    rom = make_rom((3 << 2) | 1, 0, 0x0F, 0x07, 24, 0, &size);
+    CHECK(load(rom, size, &cart) != 0, "24-byte PRG ROM rejected");
+
+    // Exponent-form CHR ROM of 512 bytes (2^9 * 1)
+    rom = make_rom(1, 9 << 2, 0xF0, 0x00, 16 * 1024, 512, &size);
+    CHECK(load(rom, size, &cart) != 0, "512-byte CHR ROM rejected");
+
+    // Smallest whole-bank image: 8KB PRG (2^13 * 1), 1KB CHR RAM (shift 4).
+    // Every PRG read and pattern-table write must stay in the buffers.
+    rom = make_rom(13 << 2, 0, 0x0F, 0x04, 8 * 1024, 0, &size);
+    for (size_t i = 0; i < 8 * 1024; ++i) rom[16 + i] = (uint8_t)i;
+    int rc = load(rom, size, &cart);
+    CHECK(rc == 0, "8KB PRG ROM with 1KB CHR RAM loads");
+    if (rc == 0) {
+        CHECK(cart.prg_rom_size == 8 * 1024 && cart.chr_size == 1024 && cart.chr_is_ram, "sizes as declared");
+        bool mirrored = true;
+        for (uint32_t a = 0x8000; a <= 0xFFFF; ++a)
+            mirrored &= cart_cpu_read(&cart, (uint16_t)a) == (uint8_t)(a & 0x1FFF);
+        CHECK(mirrored, "8KB PRG mirrors through $8000-$FFFF");
+        for (uint16_t a = 0; a < 0x2000; ++a) cart_ppu_write(&cart, a, (uint8_t)(a >> 3));
+        CHECK(cart_ppu_read(&cart, 0x0000) == cart_ppu_read(&cart, 0x1C00), "1KB CHR RAM mirrors through $0000-$1FFF");
+        cartridge_free(&cart);
+    }
+
+    if (failures) {
+        fprintf(stderr, "test_cart: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("test_cart: ok\n");
+    return 0;
+}
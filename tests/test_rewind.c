@@ -0,0 +1,109 @@
+// Rewind ring: with deltas of mixed sizes wrapping a small budget many
+// times, live records must never overlap, and stepping back through the
+// whole history must reproduce every snapshot exactly.
+//
+// Build and run: make test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nes.h"
+#include "rewind.h"
+
+#define BUDGET (64 * 1024)
+#define SNAPSHOTS 4000
+// Saved copies of the newest states; the ring can never hold more
+#define KEEP 4096
+
+static int failures;
+
+#define CHECK(cond, what) do { \
+    if (!(cond)) { fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, what); ++failures; } \
+} while (0)
+
+static uint32_t rng = 12345;
+static uint32_t next_rand(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+// 16KB NROM that spins in place, with 8KB PRG RAM
+static bool load_rom(NES *nes) {
+    size_t size = 16 + 16 * 1024 + 8 * 1024;
+    uint8_t *rom = (uint8_t*)calloc(1, size);
+    if (!rom) return false;
+    memcpy(rom, "NES\x1A", 4);
+    rom[4] = 1;
+    rom[5] = 1;
+    uint8_t *prg = rom + 16;
+    prg[0] = 0x4C; prg[1] = 0x00; prg[2] = 0x80;  // JMP $8000
+    prg[0x3FFC] = 0x00; prg[0x3FFD] = 0x80;       // reset vector
+    int rc = nes_load_rom_mem(nes, rom, size);
+    free(rom);
+    return rc == 0;
+}
+
+// Live records as ranges must be pairwise disjoint
+static bool records_disjoint(const Rewind *r) {
+    for (size_t i = 0; i < r->rec_count; ++i) {
+        size_t a = (r->rec_first + i) % r->rec_cap;
+        for (size_t j = i + 1; j < r->rec_count; ++j) {
+            size_t b = (r->rec_first + j) % r->rec_cap;
+            if (r->rec_off[a] < r->rec_off[b] + r->rec_len[b] && r->rec_off[b] < r->rec_off[a] + r->rec_len[a])
+                return false;
+        }
+    }
+    return true;
+}
+
+int main(void) {
+    NES nes;
+    nes_init(&nes);
+    if (!load_rom(&nes)) { fprintf(stderr, "test_rewind: cannot load the test ROM\n"); return 1; }
+    nes_reset(&nes);
+    size_t state_size = nes_state_size(&nes);
+    uint8_t *saved = (uint8_t*)malloc(KEEP * state_size);
+    uint8_t *now = (uint8_t*)malloc(state_size);
+    Rewind r;
+    if (!saved || !now || !rewind_init(&r, &nes, BUDGET, 1)) { fprintf(stderr, "test_rewind: out of memory\n"); return 1; }
+
+    // Mostly small deltas with bursts of large ones, so records of very
+    // different sizes wrap the ring at varying offsets
+    bool disjoint = true;
+    for (int s = 0; s < SNAPSHOTS; ++s) {
+        int changes = next_rand() % 8 == 0 ? 2000 + (int)(next_rand() % 6000) : 1 + (int)(next_rand() % 400);
+        for (int k = 0; k < changes; ++k) {
+            uint32_t at = next_rand() % (2048 + 8192);
+            uint8_t v = (uint8_t)(next_rand() | 1);
+            if (at < 2048) nes.bus.ram[at] ^= v;
+            else nes.cart.prg_ram[at - 2048] ^= v;
+        }
+        rewind_frame(&r, &nes);
+        nes_save_state(&nes, saved + (size_t)(s % KEEP) * state_size, state_size);
+        disjoint &= records_disjoint(&r);
+    }
+    CHECK(disjoint, "live records never overlap");
+    size_t depth = rewind_depth(&r);
+    CHECK(depth > 1 && depth <= KEEP, "history depth within the saved states");
+
+    // Newest first, back to the oldest snapshot still held
+    bool exact = true;
+    for (size_t d = 0; d < depth && d < KEEP; ++d) {
+        if (!rewind_step_back(&r, &nes)) { exact = false; break; }
+        nes_save_state(&nes, now, state_size);
+        exact &= memcmp(now, saved + (size_t)((SNAPSHOTS - 1 - (int)d) % KEEP) * state_size, state_size) == 0;
+    }
+    CHECK(exact, "stepping back reproduces every snapshot");
+    CHECK(rewind_depth(&r) == 0 && !rewind_step_back(&r, &nes), "history empty afterwards");
+
+    rewind_free(&r);
+    free(saved);
+    free(now);
+    nes_free(&nes);
+    if (failures) {
+        fprintf(stderr, "test_rewind: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("test_rewind: ok (%zu snapshots held)\n", depth);
+    return 0;
+}